@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Starts a server binary, parks COUNT idle keep-alive connections on it and
+# prints the server's resident memory per idle connection.
+#
+#   bench/idle.sh <port> <binary> [tls]
+#
+# Example:
+#   COUNT=10000 bench/idle.sh 8080 ./sample_one
+
+set -e
+
+COUNT=${COUNT:-10000}
+
+port=$1
+bin=$2
+tls=$3
+
+ulimit -n $((COUNT + 1024))
+
+"$bin" --rate-limit-exempt=127.0.0.1 127.0.0.1 "$port" 1 2>/dev/null &
+pid=$!
+sleep 1
+
+bench/idle_clients 127.0.0.1 "$port" "$COUNT" "$pid" $tls
+
+kill "$pid"
+wait "$pid" 2>/dev/null || true
@@ -0,0 +1,99 @@
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/stream.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using tcp  = boost::asio::ip::tcp;      // from <boost/asio/ip/tcp.hpp>
+namespace ssl  = boost::asio::ssl;      // from <boost/asio/ssl.hpp>
+namespace http = boost::beast::http;    // from <boost/beast/http.hpp>
+
+// Resident set size of a process in bytes, read from /proc
+long resident_bytes(std::string const& pid)
+{
+   std::ifstream status("/proc/" + pid + "/status");
+   for (std::string line; std::getline(status, line);)
+   {
+      if (line.compare(0, 6, "VmRSS:") == 0)
+         return std::atol(line.c_str() + 6) * 1024;
+   }
+   return 0;
+}
+
+template <class Stream>
+void round_trip(Stream& stream, char const* host)
+{
+   http::request<http::empty_body> req{http::verb::get, "/idle", 11};
+   req.set(http::field::host, host);
+   http::write(stream, req);
+
+   boost::beast::flat_buffer buffer;
+   http::response<http::string_body> res;
+   http::read(stream, buffer, res);
+}
+
+// Opens <count> keep-alive connections, sends one request on each and then
+// leaves them idle. Reports how much the server's RSS grew per connection.
+int main(int argc, char* argv[])
+{
+   if (argc != 5 && argc != 6)
+   {
+      std::cerr << "Usage: idle_clients <address> <port> <count> <server-pid> [tls]\n"
+                << "Example:\n"
+                << "    idle_clients 127.0.0.1 8080 10000 1234\n";
+      return EXIT_FAILURE;
+   }
+
+   auto const host  = argv[1];
+   auto const port  = argv[2];
+   auto const count = std::atoi(argv[3]);
+   std::string const pid{argv[4]};
+   auto const tls   = argc == 6;
+
+   boost::asio::io_context ioc;
+   ssl::context ctx{ssl::context::sslv23_client};
+   auto const endpoints = tcp::resolver{ioc}.resolve(host, port);
+
+   auto const before = resident_bytes(pid);
+
+   std::vector<tcp::socket> plain;
+   std::vector<std::unique_ptr<ssl::stream<tcp::socket>>> secure;
+   for (auto i = 0; i < count; ++i)
+   {
+      if (tls)
+      {
+         secure.push_back(std::make_unique<ssl::stream<tcp::socket>>(ioc, ctx));
+         boost::asio::connect(secure.back()->next_layer(), endpoints);
+         secure.back()->handshake(ssl::stream_base::client);
+         round_trip(*secure.back(), host);
+      }
+      else
+      {
+         plain.emplace_back(ioc);
+         boost::asio::connect(plain.back(), endpoints);
+         round_trip(plain.back(), host);
+      }
+   }
+
+   // Give the sessions time to go idle
+   std::this_thread::sleep_for(std::chrono::seconds(1));
+
+   auto const after = resident_bytes(pid);
+
+   std::cout << "connections:            " << count << "\n"
+             << "server rss before:      " << before << " bytes\n"
+             << "server rss after:       " << after << " bytes\n"
+             << "rss per idle connection: " << (after - before) / std::max(count, 1) << " bytes\n";
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using tcp       = boost::asio::ip::tcp;      // from <boost/asio/ip/tcp.hpp>
+namespace local = boost::asio::local;        // from <boost/asio/local/stream_protocol.hpp>
+namespace ssl   = boost::asio::ssl;          // from <boost/asio/ssl.hpp>
+namespace http  = boost::beast::http;        // from <boost/beast/http.hpp>
+
+// Sends keep-alive requests back to back on one connection until stopped
+template <class Stream>
+class load_session : public std::enable_shared_from_this<load_session<Stream>>
+{
+   Stream stream_;
+   http::request<http::empty_body> const& req_;
+   boost::beast::flat_buffer buffer_;
+   http::response<http::string_body> res_;
+   bool const& stopped_;
+   std::vector<std::uint64_t>& latencies_;
+   std::uint64_t& errors_;
+   std::chrono::steady_clock::time_point sent_;
+
+public:
+   template <class... Args>
+   load_session(http::request<http::empty_body> const& req, bool const& stopped, std::vector<std::uint64_t>& latencies, std::uint64_t& errors, Args&&... args)
+      : stream_(std::forward<Args>(args)...)
+      , req_(req)
+      , stopped_(stopped)
+      , latencies_(latencies)
+      , errors_(errors)
+   {
+   }
+
+   Stream& stream()
+   {
+      return stream_;
+   }
+
+   void run()
+   {
+      sent_ = std::chrono::steady_clock::now();
+
+      auto&& on_write = [self = this->shared_from_this()](auto ec, std::size_t)
+      {
+         if (ec)
+            return;
+
+         self->schedule_read();
+      };
+
+      http::async_write(stream_, req_, std::move(on_write));
+   }
+
+private:
+   void schedule_read()
+   {
+      res_ = {};
+
+      auto&& on_read = [self = this->shared_from_this()](auto ec, std::size_t)
+      {
+         if (ec)
+            return;
+
+         auto const latency = std::chrono::steady_clock::now() - self->sent_;
+         self->latencies_.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+
+         // Such as 429s from the rate limiter, which would flatter the rate
+         if (self->res_.result_int() / 100 != 2)
+            ++self->errors_;
+         if (!self->stopped_)
+            self->run();
+      };
+
+      http::async_read(stream_, buffer_, res_, std::move(on_read));
+   }
+};
+
+// Drives a server over loopback from several keep-alive connections and
+// prints the rate of completed requests and their latency, and how many
+// were not answered with a 2xx. Used to train
+// PGO builds and to compare builds and endpoints.
+int main(int argc, char* argv[])
+{
+   if (argc != 6 && argc != 7)
+   {
+      std::cerr << "Usage: loopback_load <address> <port> <target> <connections> <seconds> [tls]\n"
+                << "Example:\n"
+                << "    loopback_load 127.0.0.1 8080 /bench 64 10\n"
+                << "    loopback_load unix:/tmp/sample_one.sock 0 /bench 1 10\n";
+      return EXIT_FAILURE;
+   }
+
+   auto const host        = argv[1];
+   auto const port        = argv[2];
+   auto const target      = argv[3];
+   auto const connections = std::max(1, std::atoi(argv[4]));
+   auto const seconds     = std::chrono::seconds(std::max(1, std::atoi(argv[5])));
+   auto const tls         = argc == 7;
+   auto const unix_path   = std::string{host}.compare(0, 5, "unix:") == 0 ? std::string{host + 5} : std::string{};
+
+   boost::asio::io_context ioc;
+   ssl::context ctx{ssl::context::sslv23_client};
+   auto const endpoints = unix_path.empty() ? tcp::resolver{ioc}.resolve(host, port) : tcp::resolver::results_type{};
+
+   http::request<http::empty_body> req{http::verb::get, target, 11};
+   req.set(http::field::host, unix_path.empty() ? host : "localhost");
+
+   bool stopped = false;
+   std::vector<std::uint64_t> latencies;
+   latencies.reserve(1 << 20);
+   std::uint64_t errors = 0;
+
+   for (auto i = 0; i < connections; ++i)
+   {
+      if (!unix_path.empty() && tls)
+      {
+         auto s = std::make_shared<load_session<ssl::stream<local::stream_protocol::socket>>>(req, stopped, latencies, errors, ioc, ctx);
+         s->stream().next_layer().connect(local::stream_protocol::endpoint{unix_path});
+         s->stream().handshake(ssl::stream_base::client);
+         s->run();
+      }
+      else if (!unix_path.empty())
+      {
+         auto s = std::make_shared<load_session<local::stream_protocol::socket>>(req, stopped, latencies, errors, ioc);
+         s->stream().connect(local::stream_protocol::endpoint{unix_path});
+         s->run();
+      }
+      else if (tls)
+      {
+         auto s = std::make_shared<load_session<ssl::stream<tcp::socket>>>(req, stopped, latencies, errors, ioc, ctx);
+         boost::asio::connect(s->stream().next_layer(), endpoints);
+         s->stream().handshake(ssl::stream_base::client);
+         s->run();
+      }
+      else
+      {
+         auto s = std::make_shared<load_session<tcp::socket>>(req, stopped, latencies, errors, ioc);
+         boost::asio::connect(s->stream(), endpoints);
+         s->run();
+      }
+   }
+
+   boost::asio::steady_timer timer{ioc, seconds};
+   timer.async_wait([&](auto) { stopped = true; });
+
+   auto const start = std::chrono::steady_clock::now();
+   ioc.run();
+   auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   std::sort(latencies.begin(), latencies.end());
+   auto const percentile = [&](double p) {
+      return latencies.empty() ? 0 : latencies[static_cast<std::size_t>(p * (latencies.size() - 1))] / 1000;
+   };
+
+   std::cout << "requests/sec: " << static_cast<std::uint64_t>(latencies.size() / elapsed)
+             << ", p50: " << percentile(0.5) << "us"
+             << ", p99: " << percentile(0.99) << "us";
+   if (errors)
+      std::cout << ", non-2xx: " << errors;
+   std::cout << "\n";
+
+   return EXIT_SUCCESS;
+}
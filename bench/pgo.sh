@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Builds the samples twice, plain -O2 and LTO with profile-guided
+# optimization trained on the loopback workload, optionally post-links the
+# optimized sample_one with llvm-bolt, and prints requests/sec for each.
+#
+#   bench/pgo.sh [<output-dir>]
+#
+# CONNECTIONS, TRAIN_SECONDS and SECONDS_PER_RUN tune the workload.
+
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+out=${1:-$src/_pgo}
+jobs=$(nproc 2>/dev/null || echo 2)
+
+CONNECTIONS=${CONNECTIONS:-64}
+TRAIN_SECONDS=${TRAIN_SECONDS:-10}
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-10}
+
+# load <binary> <port> <seconds> [tls], prints the loader's requests/sec
+load()
+{
+   bin=$1
+   port=$2
+   seconds=$3
+   tls=$4
+
+   "$bin" --rate-limit-exempt=127.0.0.1 127.0.0.1 "$port" 1 >/dev/null 2>&1 &
+   pid=$!
+   sleep 1
+
+   "$out/o2/loopback_load" 127.0.0.1 "$port" /bench "$CONNECTIONS" "$seconds" $tls
+
+   # SIGTERM shuts the server down cleanly, which writes out its profile
+   kill "$pid"
+   wait "$pid" 2>/dev/null || true
+}
+
+echo "== building -O2 baseline"
+cmake -S "$src" -B "$out/o2" -DCMAKE_BUILD_TYPE=Release >/dev/null
+cmake --build "$out/o2" -j "$jobs" >/dev/null
+
+echo "== building instrumented LTO binaries"
+rm -rf "$out/profile"
+cmake -S "$src" -B "$out/pgo" -DCMAKE_BUILD_TYPE=Release -DLIBWEB_LTO=ON -DLIBWEB_PGO=GENERATE -DLIBWEB_PGO_DIR="$out/profile" >/dev/null
+cmake --build "$out/pgo" -j "$jobs" --target sample_one sample_two >/dev/null
+
+echo "== training on the loopback workload"
+load "$out/pgo/sample_one" 18080 "$TRAIN_SECONDS" >/dev/null
+load "$out/pgo/sample_two" 18443 "$TRAIN_SECONDS" tls >/dev/null
+
+# Clang writes raw profiles that have to be merged; GCC reads its own
+if ls "$out/profile"/*.profraw >/dev/null 2>&1
+then
+   llvm-profdata merge -o "$out/profile/default.profdata" "$out/profile"/*.profraw
+fi
+
+echo "== rebuilding with the profile"
+cmake -S "$src" -B "$out/pgo" -DLIBWEB_PGO=USE -DLIBWEB_BOLT=ON >/dev/null
+cmake --build "$out/pgo" -j "$jobs" --target sample_one sample_two >/dev/null
+
+bolted=
+if command -v llvm-bolt >/dev/null 2>&1
+then
+   echo "== post-linking sample_one with llvm-bolt"
+   llvm-bolt "$out/pgo/sample_one" -instrument -instrumentation-file="$out/profile/bolt.fdata" -o "$out/pgo/sample_one.instrumented" >/dev/null
+   load "$out/pgo/sample_one.instrumented" 18080 "$TRAIN_SECONDS" >/dev/null
+   llvm-bolt "$out/pgo/sample_one" -data="$out/profile/bolt.fdata" -o "$out/pgo/sample_one.bolt" \
+      -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -dyno-stats >/dev/null
+   bolted="$out/pgo/sample_one.bolt"
+fi
+
+echo "== requests/sec, $CONNECTIONS connections, ${SECONDS_PER_RUN}s each"
+printf '%-28s %s\n' "sample_one -O2" "$(load "$out/o2/sample_one" 18080 "$SECONDS_PER_RUN")"
+printf '%-28s %s\n' "sample_one LTO+PGO" "$(load "$out/pgo/sample_one" 18080 "$SECONDS_PER_RUN")"
+if [ -n "$bolted" ]
+then
+   printf '%-28s %s\n' "sample_one LTO+PGO+BOLT" "$(load "$bolted" 18080 "$SECONDS_PER_RUN")"
+fi
+printf '%-28s %s\n' "sample_two -O2" "$(load "$out/o2/sample_two" 18443 "$SECONDS_PER_RUN" tls)"
+printf '%-28s %s\n' "sample_two LTO+PGO" "$(load "$out/pgo/sample_two" 18443 "$SECONDS_PER_RUN" tls)"
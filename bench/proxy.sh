@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Compares requests answered directly with requests forwarded through the
+# proxy route to a local upstream.
+#
+#   bench/proxy.sh <binary>
+#
+# Example:
+#   bench/proxy.sh ./sample_one
+
+set -e
+
+bin=$1
+
+"$bin" --rate-limit-exempt=127.0.0.1 127.0.0.1 9000 1 >/dev/null 2>&1 &
+upstream=$!
+sleep 1
+
+echo "direct"
+bench/run.sh http 8080 "$bin"
+
+echo "proxied to 127.0.0.1:9000"
+SERVER_ARGS="/api/=http://127.0.0.1:9000" TARGET=/api/bench bench/run.sh http 8080 "$bin"
+
+kill "$upstream"
+wait "$upstream" 2>/dev/null || true
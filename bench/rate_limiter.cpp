@@ -0,0 +1,122 @@
+#include "../rate_limiter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures the cost of rate_limiter::admit, and what well-behaved clients
+// still get through while another client floods.
+
+// Calls admit `count` times per thread over `clients` distinct clients (a
+// power of two) and returns the average nanoseconds per call
+double admit_cost(rate_limiter& limiter, int threads, std::uint64_t count, std::uint64_t clients)
+{
+   std::atomic<std::uint64_t> admitted{0};
+
+   auto const start = std::chrono::steady_clock::now();
+
+   std::vector<std::thread> v;
+   for (int t = 0; t < threads; ++t)
+   {
+      v.emplace_back([&, t] {
+         std::uint64_t ok = 0;
+         for (std::uint64_t i = 0; i < count; ++i)
+            ok += limiter.admit((i + t * 7919) & (clients - 1), "/api/items") == 0;
+         admitted += ok;
+      });
+   }
+   for (auto& th : v)
+      th.join();
+
+   auto const elapsed = std::chrono::steady_clock::now() - start;
+   return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+}
+
+struct traffic
+{
+   std::uint64_t sent = 0;
+   std::uint64_t admitted = 0;
+};
+
+struct abuse_result
+{
+   traffic paced;
+   traffic flood;
+};
+
+// For `seconds` of real time, 1000 clients each send a request every 100 ms,
+// spread evenly, while one more client sends requests for `flood` as fast as
+// it can, unless `flood` is null
+abuse_result abuse(rate_limiter& limiter, int seconds, char const* flood)
+{
+   using clock = std::chrono::steady_clock;
+
+   constexpr std::uint64_t clients = 1000;
+   constexpr auto period = std::chrono::milliseconds(100);
+
+   abuse_result r;
+
+   auto const start = clock::now();
+   std::vector<clock::time_point> next(clients);
+   for (std::uint64_t c = 0; c < clients; ++c)
+      next[c] = start + period * c / clients;
+
+   for (auto now = start; now < start + std::chrono::seconds(seconds); now = clock::now())
+   {
+      if (flood)
+      {
+         for (int i = 0; i < 100; ++i)
+         {
+            ++r.flood.sent;
+            r.flood.admitted += limiter.admit(0xdeadbeef, flood) == 0;
+         }
+      }
+
+      for (std::uint64_t c = 0; c < clients; ++c)
+      {
+         for (; next[c] <= now; next[c] += period)
+         {
+            ++r.paced.sent;
+            r.paced.admitted += limiter.admit(c + 1, "/api/items") == 0;
+         }
+      }
+   }
+
+   return r;
+}
+
+int main(int argc, char* argv[])
+{
+   auto const threads = argc > 1 ? std::max(1, std::atoi(argv[1])) : int(std::thread::hardware_concurrency());
+   std::uint64_t const count = 10000000;
+
+   std::cout << "admit() cost, ns per call per thread\n";
+   for (std::uint64_t clients : {1ull, 1ull << 10, 1ull << 20})
+   {
+      for (int t : {1, threads})
+      {
+         rate_limiter limiter{rate_limit{1000, 2000}};
+         limiter.add_route("/api/", rate_limit{500, 1000});
+         std::cout << "   clients " << clients << ", threads " << t << ": " << admit_cost(limiter, t, count / t, clients) << "\n";
+      }
+   }
+
+   // The per-client limit is ten times what the paced clients send
+   std::cout << "abuse, 1000 clients at 10 req/s each, limited to 100 req/s per client\n";
+   for (char const* flood : {static_cast<char const*>(nullptr), "/api/items"})
+   {
+      rate_limiter limiter{rate_limit{100, 200}};
+      auto const r = abuse(limiter, 2, flood);
+
+      std::cout << (flood ? "   one client flooding\n" : "   no flood\n")
+                << "      well-behaved admitted: " << r.paced.admitted / 2 << " of " << r.paced.sent / 2 << " req/s\n";
+      if (flood)
+         std::cout << "      flooding admitted:     " << r.flood.admitted / 2 << " of " << r.flood.sent / 2 << " req/s\n";
+   }
+
+   return EXIT_SUCCESS;
+}
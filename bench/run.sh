@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Runs a fixed HTTP load against each server binary given on the command
+# line and prints one line per (binary, connection count).
+#
+#   bench/run.sh <scheme> <port> <binary>...
+#
+# Example:
+#   bench/run.sh http 8080 ./sample_one ./sample_one_uring
+#
+# SERVER_ARGS is appended to each server's command line and TARGET is the
+# path requested.
+#
+# With SYSCALLS=1, strace -c counts the server's system calls during each
+# run and the last column gives them per request. strace slows the server
+# down, so take requests/sec and latency from a run without it.
+#
+# The load comes from 127.0.0.1, which each server exempts from its rate
+# limit, as the other scripts here do.
+
+set -e
+
+WRK=${WRK:-wrk}
+THREADS=${THREADS:-1}
+DURATION=${DURATION:-10s}
+CONNECTIONS=${CONNECTIONS:-"10 100 1000"}
+TARGET=${TARGET:-/bench}
+
+scheme=$1
+port=$2
+shift 2
+
+printf '%-24s %8s %14s %12s %14s\n' binary conns requests/sec latency syscalls/req
+for bin in "$@"
+do
+   "$bin" --rate-limit-exempt=127.0.0.1 127.0.0.1 "$port" "$THREADS" $SERVER_ARGS >/dev/null 2>&1 &
+   pid=$!
+   sleep 1
+
+   for c in $CONNECTIONS
+   do
+      if [ -n "$SYSCALLS" ]
+      then
+         strace -c -f -q -p "$pid" -o /tmp/bench.$$.strace &
+         spid=$!
+         sleep 1
+      fi
+
+      "$WRK" -t "$THREADS" -c "$c" -d "$DURATION" "$scheme://127.0.0.1:$port$TARGET" > /tmp/bench.$$ 2>&1 || true
+      rps=$(awk '/^Requests\/sec/ { print $2 }' /tmp/bench.$$)
+      lat=$(awk '/^ *Latency/ { print $2 }' /tmp/bench.$$)
+
+      per_request=
+      if [ -n "$SYSCALLS" ]
+      then
+         kill -INT "$spid"
+         wait "$spid" 2>/dev/null || true
+         requests=$(awk '/ requests in / { print $1 }' /tmp/bench.$$)
+         calls=$(awk '$NF == "total" { print $4 }' /tmp/bench.$$.strace)
+         per_request=$(awk -v calls="$calls" -v requests="$requests" 'BEGIN { if (requests > 0) printf "%.2f", calls / requests }')
+      fi
+
+      printf '%-24s %8s %14s %12s %14s\n' "$(basename "$bin")" "$c" "${rps:--}" "${lat:--}" "${per_request:--}"
+   done
+
+   kill "$pid"
+   wait "$pid" 2>/dev/null || true
+done
+
+rm -f /tmp/bench.$$ /tmp/bench.$$.strace
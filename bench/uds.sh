@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+# Compares latency and throughput of the same server over loopback TCP and
+# over a Unix domain socket.
+#
+#   bench/uds.sh <binary> <loopback_load> [tls]
+#
+# Example:
+#   bench/uds.sh ./sample_one ./loopback_load
+
+set -e
+
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-10}
+CONNECTIONS=${CONNECTIONS:-"1 16 64"}
+
+bin=$1
+loader=$2
+tls=$3
+sock=/tmp/libweb_bench.sock
+
+"$bin" --rate-limit-exempt=127.0.0.1 127.0.0.1 18080 1 >/dev/null 2>&1 &
+tcp_pid=$!
+"$bin" "unix:$sock" 0 1 >/dev/null 2>&1 &
+uds_pid=$!
+sleep 1
+
+for c in $CONNECTIONS
+do
+   printf '%-6s %6s  %s\n' tcp "$c" "$("$loader" 127.0.0.1 18080 /bench "$c" "$SECONDS_PER_RUN" $tls)"
+   printf '%-6s %6s  %s\n' unix "$c" "$("$loader" "unix:$sock" 0 /bench "$c" "$SECONDS_PER_RUN" $tls)"
+done
+
+kill "$tcp_pid" "$uds_pid"
+wait 2>/dev/null || true
+rm -f "$sock"
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/beast/core/flat_buffer.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Read buffers handed back by idle sessions.
+//
+// Every thread keeps its own free list, so acquiring and releasing never
+// takes a lock. A buffer simply moves to whichever thread the session that
+// borrowed it happens to run on next.
+class buffer_pool
+{
+   // Upper bound on the buffers kept per thread
+   static constexpr std::size_t max_free = 256;
+
+   // Buffers grown past this by a large request go back to the allocator
+   static constexpr std::size_t max_capacity = 16 * 1024;
+
+   static std::vector<boost::beast::flat_buffer>& free_list()
+   {
+      thread_local std::vector<boost::beast::flat_buffer> list;
+      return list;
+   }
+
+public:
+   // Returns an empty buffer, reusing a released one if there is any
+   static boost::beast::flat_buffer acquire()
+   {
+      auto& list = free_list();
+      if (list.empty())
+         return {};
+
+      auto buffer = std::move(list.back());
+      list.pop_back();
+      return buffer;
+   }
+
+   // Takes the buffer back. The caller's buffer is left without storage.
+   static void release(boost::beast::flat_buffer buffer)
+   {
+      auto& list = free_list();
+      if (buffer.capacity() == 0 || buffer.capacity() > max_capacity || list.size() >= max_free)
+         return;
+
+      buffer.clear();
+      list.push_back(std::move(buffer));
+   }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Adds the bytes a read transferred to a counter, then completes `Handler`
+template <class Handler>
+struct counted_read_handler
+{
+   Handler handler;
+   std::uint64_t* bytes_read;
+
+   void operator()(boost::system::error_code const& ec, std::size_t bytes_transferred)
+   {
+      *bytes_read += bytes_transferred;
+      handler(ec, bytes_transferred);
+   }
+};
+
+// The counted handler runs on, and allocates from, whatever the handler it
+// wraps would, so a strand bound to that handler still applies
+template <class Handler, class Executor>
+struct boost::asio::associated_executor<counted_read_handler<Handler>, Executor>
+{
+   using type = typename associated_executor<Handler, Executor>::type;
+
+   static type get(counted_read_handler<Handler> const& h, Executor const& ex = Executor())
+   {
+      return associated_executor<Handler, Executor>::get(h.handler, ex);
+   }
+};
+
+template <class Handler, class Allocator>
+struct boost::asio::associated_allocator<counted_read_handler<Handler>, Allocator>
+{
+   using type = typename associated_allocator<Handler, Allocator>::type;
+
+   static type get(counted_read_handler<Handler> const& h, Allocator const& a = Allocator())
+   {
+      return associated_allocator<Handler, Allocator>::get(h.handler, a);
+   }
+};
+
+// Counts the bytes read from `Stream`, which it refers to but does not own.
+//
+// Used as the next layer of an ssl::stream. Comparing the count with what
+// OpenSSL has consumed shows whether ciphertext is still buffered anywhere
+// between the socket and the TLS engine.
+template <class Stream>
+class counting_stream
+{
+   Stream& next_layer_;
+   std::uint64_t bytes_read_ = 0;
+
+public:
+   using next_layer_type   = Stream;
+   using lowest_layer_type = typename Stream::lowest_layer_type;
+   using executor_type     = typename Stream::executor_type;
+
+   explicit counting_stream(Stream& next_layer)
+      : next_layer_(next_layer)
+   {
+   }
+
+   // Bytes read so far
+   std::uint64_t bytes_read() const
+   {
+      return bytes_read_;
+   }
+
+   executor_type get_executor()
+   {
+      return next_layer_.get_executor();
+   }
+
+   next_layer_type& next_layer()
+   {
+      return next_layer_;
+   }
+
+   lowest_layer_type& lowest_layer()
+   {
+      return next_layer_.lowest_layer();
+   }
+
+   lowest_layer_type const& lowest_layer() const
+   {
+      return next_layer_.lowest_layer();
+   }
+
+   template <class MutableBuffers>
+   std::size_t read_some(MutableBuffers const& buffers, boost::system::error_code& ec)
+   {
+      auto const n = next_layer_.read_some(buffers, ec);
+      bytes_read_ += n;
+      return n;
+   }
+
+   template <class ConstBuffers>
+   std::size_t write_some(ConstBuffers const& buffers, boost::system::error_code& ec)
+   {
+      return next_layer_.write_some(buffers, ec);
+   }
+
+   template <class MutableBuffers, class Handler>
+   void async_read_some(MutableBuffers const& buffers, Handler&& handler)
+   {
+      next_layer_.async_read_some(buffers, counted_read_handler<std::decay_t<Handler>>{std::forward<Handler>(handler), &bytes_read_});
+   }
+
+   template <class ConstBuffers, class Handler>
+   void async_write_some(ConstBuffers const& buffers, Handler&& handler)
+   {
+      next_layer_.async_write_some(buffers, std::forward<Handler>(handler));
+   }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/optional.hpp>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+
+// A socket option holding an int, for the options Asio has no class for
+template <int Level, int Name>
+class int_option
+{
+   int value_;
+
+public:
+   explicit int_option(int value)
+      : value_(value)
+   {
+   }
+
+   template <class Protocol>
+   int level(Protocol const&) const
+   {
+      return Level;
+   }
+
+   template <class Protocol>
+   int name(Protocol const&) const
+   {
+      return Name;
+   }
+
+   template <class Protocol>
+   int const* data(Protocol const&) const
+   {
+      return &value_;
+   }
+
+   template <class Protocol>
+   std::size_t size(Protocol const&) const
+   {
+      return sizeof(value_);
+   }
+};
+
+// Socket options the listener applies. Zero leaves the kernel's default.
+// Buffer sizes and the backlog apply to every endpoint, the rest only to TCP.
+struct socket_tuning
+{
+   // TCP_NODELAY on accepted sockets, so responses are not held back
+   bool no_delay = true;
+
+   // TCP_DEFER_ACCEPT, wakes the acceptor only once the request arrives
+   std::chrono::seconds defer_accept{0};
+
+   // TCP_FASTOPEN queue length, lets clients send data with the SYN
+   int fastopen_queue = 0;
+
+   // SO_BUSY_POLL on accepted sockets, spins on the device queue on reads
+   std::chrono::microseconds busy_poll{0};
+
+   // SO_SNDBUF and SO_RCVBUF, inherited by accepted sockets
+   int send_buffer    = 0;
+   int receive_buffer = 0;
+
+   int backlog = boost::asio::socket_base::max_listen_connections;
+};
+
+template <class Protocol>
+constexpr bool is_tcp = std::is_same<Protocol, boost::asio::ip::tcp>::value;
+
+// Returns the peer's IP address, or nothing for sockets without one
+template <class Socket>
+boost::optional<boost::asio::ip::address> peer_address(Socket& socket)
+{
+   if constexpr (is_tcp<typename Socket::protocol_type>)
+   {
+      boost::system::error_code ec;
+      auto const peer = socket.remote_endpoint(ec);
+      if (!ec)
+         return peer.address();
+   }
+
+   return boost::none;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <boost/version.hpp>
+
+#if defined(BOOST_ASIO_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <string>
+#endif
+
+// Asio chooses its reactor when it is compiled, not when the program starts.
+// The *_uring targets add URING_CXXFLAGS (see the Makefile), which define
+// BOOST_ASIO_HAS_IO_URING and BOOST_ASIO_DISABLE_EPOLL, so accept, read,
+// write and the session timers are all submitted to io_uring. Without those
+// flags the epoll reactor is used.
+//
+// Registered buffers and fixed files are not used yet. Asio offers the
+// former from 1.78 on (asio::register_buffers), but Beast reads into its
+// own dynamic buffers, so the sessions would have to read into registered
+// pool slots themselves. Nor has this backend been measured against epoll:
+// bench/run.sh compares the two, with SYSCALLS=1 for the syscall counts.
+#if defined(BOOST_ASIO_HAS_IO_URING) && BOOST_VERSION < 107800
+#error "The io_uring backend needs Boost.Asio 1.78 or newer"
+#endif
+
+// What a session's timer is constructed from. Up to Boost 1.69 sockets
+// carry an io_context executor and timers need the io_context itself;
+// from 1.70 on, sockets carry a polymorphic executor that timers accept.
+template <class Socket>
+decltype(auto) timer_context(Socket& socket)
+{
+#if BOOST_VERSION < 107000
+   return (socket.get_executor().context());
+#else
+   return socket.get_executor();
+#endif
+}
+
+// Name of the I/O backend this binary was built with
+inline char const* io_backend_name()
+{
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+   return "io_uring";
+#else
+   return "epoll";
+#endif
+}
+
+// Whether the running kernel supports the backend. io_uring can be missing
+// from older kernels, or disabled by sysctl or a seccomp profile.
+inline bool io_backend_available()
+{
+#if defined(BOOST_ASIO_HAS_IO_URING)
+   io_uring_params params{};
+   auto const fd = ::syscall(__NR_io_uring_setup, 1, &params);
+   if (fd < 0)
+      return false;
+   ::close(static_cast<int>(fd));
+#endif
+   return true;
+}
+
+// Replaces this process with the epoll build of the same sample, which is
+// the *_uring binary's name without the suffix. Returns only on failure.
+inline void exec_epoll_fallback(char* argv[])
+{
+#if defined(BOOST_ASIO_HAS_IO_URING)
+   std::string path{argv[0]};
+   auto const suffix = path.rfind("_uring");
+   if (suffix == std::string::npos)
+      return;
+
+   path.erase(suffix, 6);
+   ::execvp(path.c_str(), argv);
+#else
+   (void)argv;
+#endif
+}
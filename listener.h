@@ -1,28 +1,67 @@
 #pragma once
 
+#include "endpoint.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 // Accepts incoming connections and launches the sessions
-template <class SessionRunner>
-class listener : public std::enable_shared_from_this<listener<SessionRunner>>
+template <class SessionRunner, class Protocol = tcp>
+class listener : public std::enable_shared_from_this<listener<SessionRunner, Protocol>>
 {
-   tcp::acceptor acceptor_;
-   tcp::socket accepted_socket_;
+   typename Protocol::acceptor acceptor_;
+   typename Protocol::socket accepted_socket_;
+   socket_tuning tuning_;
+
+   template <class Option>
+   void set_option(Option const& option, char const* what)
+   {
+      boost::system::error_code ec;
+      acceptor_.set_option(option, ec);
+      if (ec)
+         fail(ec, what);
+   }
 
 public:
-   listener(boost::asio::io_context& ioc, tcp::endpoint endpoint)
+   listener(boost::asio::io_context& ioc, typename Protocol::endpoint endpoint, socket_tuning const& tuning = {})
       : acceptor_(ioc)
       , accepted_socket_(ioc)
+      , tuning_(tuning)
    {
       // Open the acceptor
       acceptor_.open(endpoint.protocol());
 
-      // Allow address reuse
-      acceptor_.set_option(boost::asio::socket_base::reuse_address(true));
+      if constexpr (is_tcp<Protocol>)
+      {
+         // Allow address reuse
+         acceptor_.set_option(boost::asio::socket_base::reuse_address(true));
+
+#if defined(TCP_DEFER_ACCEPT)
+         if (tuning_.defer_accept.count() > 0)
+            set_option(int_option<IPPROTO_TCP, TCP_DEFER_ACCEPT>(tuning_.defer_accept.count()), "TCP_DEFER_ACCEPT");
+#endif
+
+#if defined(TCP_FASTOPEN)
+         if (tuning_.fastopen_queue > 0)
+            set_option(int_option<IPPROTO_TCP, TCP_FASTOPEN>(tuning_.fastopen_queue), "TCP_FASTOPEN");
+#endif
+      }
+      else
+      {
+         remove_stale_socket(ioc, endpoint);
+      }
+
+      // Accepted sockets inherit the buffer sizes
+      if (tuning_.send_buffer > 0)
+         set_option(boost::asio::socket_base::send_buffer_size(tuning_.send_buffer), "SO_SNDBUF");
+      if (tuning_.receive_buffer > 0)
+         set_option(boost::asio::socket_base::receive_buffer_size(tuning_.receive_buffer), "SO_RCVBUF");
 
       // Bind to the server address
       acceptor_.bind(endpoint);
 
       // Start listening for connections
-      acceptor_.listen(boost::asio::socket_base::max_listen_connections);
+      acceptor_.listen(tuning_.backlog);
    }
 
    // Start accepting incoming connections
@@ -36,6 +75,7 @@ public:
          }
          else
          {
+            self->tune(self->accepted_socket_);
             std::make_shared<SessionRunner>(std::move(self->accepted_socket_), args...)->run();
          }
 
@@ -43,5 +83,47 @@ public:
          self->run(args...);
       });
    }
-};
 
+private:
+   // Removes the socket file left behind by an earlier run. Only a socket
+   // that refuses connections is stale: a regular file at the path, or the
+   // socket of a server still running, is left alone and the bind fails.
+   static void remove_stale_socket(boost::asio::io_context& ioc, typename Protocol::endpoint const& endpoint)
+   {
+      struct stat st;
+      if (::lstat(endpoint.path().c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+         return;
+
+      boost::system::error_code ec;
+      typename Protocol::socket probe(ioc);
+      probe.connect(endpoint, ec);
+      if (ec == boost::asio::error::connection_refused)
+         ::unlink(endpoint.path().c_str());
+   }
+
+   // Applies the per-connection options, failures are reported but not
+   // fatal
+   void tune(typename Protocol::socket& socket)
+   {
+      if constexpr (is_tcp<Protocol>)
+      {
+         boost::system::error_code ec;
+
+         if (tuning_.no_delay)
+         {
+            socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+            if (ec)
+               fail(ec, "TCP_NODELAY");
+         }
+
+#if defined(SO_BUSY_POLL)
+         if (tuning_.busy_poll.count() > 0)
+         {
+            socket.set_option(int_option<SOL_SOCKET, SO_BUSY_POLL>(tuning_.busy_poll.count()), ec);
+            if (ec)
+               fail(ec, "SO_BUSY_POLL");
+         }
+#endif
+      }
+   }
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Buffers log lines per thread and writes them out in large chunks.
+//
+// Appending never locks or touches shared state: every thread fills its own
+// buffer and hands it to write(2) once it is big enough or old enough, or
+// when the thread exits.
+//
+// The age is only checked when a line is written. A thread that goes quiet
+// keeps its last lines until it calls flush(), so every thread that writes
+// lines should also call flush() at least every flush_age.
+class log_writer
+{
+   // Flush once a thread has buffered this much
+   static constexpr std::size_t flush_size = 64 * 1024;
+
+   struct buffer
+   {
+      int fd = -1;
+      std::string data;
+      std::chrono::steady_clock::time_point flushed_at;
+
+      ~buffer()
+      {
+         flush();
+      }
+
+      void flush()
+      {
+         auto const* p = data.data();
+         auto n = data.size();
+         while (n > 0)
+         {
+            auto const written = ::write(fd, p, n);
+            if (written < 0 && errno == EINTR)
+               continue;
+            if (written <= 0)
+               break;
+            p += written;
+            n -= written;
+         }
+         data.clear();
+      }
+   };
+
+   int fd_;
+
+   buffer& local()
+   {
+      thread_local buffer b;
+      if (b.fd != fd_)
+      {
+         b.flush();
+         b.fd = fd_;
+         b.data.reserve(flush_size);
+      }
+      return b;
+   }
+
+public:
+   // Lines written this long after the buffer was last flushed flush it
+   static constexpr std::chrono::seconds flush_age{1};
+
+   explicit log_writer(int fd)
+      : fd_(fd)
+   {
+   }
+
+   // Appends the pieces as one line, `now` is used to age the buffer
+   template <class... Pieces>
+   void write_line(std::chrono::steady_clock::time_point now, Pieces const&... pieces)
+   {
+      auto& b = local();
+      (b.data.append(pieces.data(), pieces.size()), ...);
+      b.data.push_back('\n');
+
+      if (b.data.size() >= flush_size || now - b.flushed_at >= flush_age)
+      {
+         b.flush();
+         b.flushed_at = now;
+      }
+   }
+
+   // Writes out the lines the calling thread has buffered
+   void flush()
+   {
+      auto& b = local();
+      b.flush();
+      b.flushed_at = std::chrono::steady_clock::now();
+   }
+};
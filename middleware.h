@@ -0,0 +1,276 @@
+#pragma once
+
+#include "log_writer.h"
+
+#include <boost/beast/core/static_string.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http.hpp>
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+// Runs a fixed list of middlewares around a request handler.
+//
+// The list is a template parameter pack, so every hook is a direct call the
+// compiler can inline; there is no std::function or virtual dispatch per
+// request. A middleware provides
+//
+//    struct context { ... };
+//
+//    template <class Request, class Context, class Respond>
+//    bool before(Request& req, Context& ctx, Respond& respond);
+//
+//    template <class Message, class Context>
+//    void after(Message& res, Context& ctx);
+//
+// `before` runs in list order. Returning `false` stops the chain; the
+// middleware must then have passed its own response to `respond`. `after`
+// runs in reverse order on whatever response is sent, and may change its
+// header. The per-request context inherits every middleware's `context`,
+// and is also handed to the handler.
+template <class... Middlewares>
+class middleware_chain
+{
+   std::tuple<Middlewares...> stages_;
+
+public:
+   struct context_type : Middlewares::context...
+   {
+   };
+
+   explicit middleware_chain(Middlewares... stages)
+      : stages_(std::move(stages)...)
+   {
+   }
+
+   // Calls `handler(std::move(req), ctx, respond)` unless a middleware
+   // answers first. The handler must respond before it returns.
+   template <class Request, class Handler, class Sender>
+   void operator()(Request&& req, Handler&& handler, Sender& sender)
+   {
+      context_type ctx;
+      if (!before(req, ctx, sender))
+         return;
+
+      auto&& respond = [this, &ctx, &sender](auto&& msg)
+      {
+         this->after(msg, ctx);
+         sender(std::move(msg));
+      };
+
+      handler(std::move(req), ctx, respond);
+   }
+
+   // Runs the `before` hooks on their own, for requests answered later.
+   // Returns `false` if a middleware answered, through `sender`. Otherwise
+   // the eventual response must be passed to after() with the same context.
+   template <class Request, class Sender>
+   bool before(Request& req, context_type& ctx, Sender& sender)
+   {
+      return before<0>(req, ctx, sender);
+   }
+
+   // Runs every `after` hook, in reverse order, on the response to a
+   // request that passed all the `before` hooks
+   template <class Message>
+   void after(Message& msg, context_type& ctx)
+   {
+      unwind<sizeof...(Middlewares)>(msg, ctx);
+   }
+
+private:
+   template <std::size_t I, class Request, class Sender>
+   bool before(Request& req, context_type& ctx, Sender& sender)
+   {
+      if constexpr (I == sizeof...(Middlewares))
+      {
+         return true;
+      }
+      else
+      {
+         // Responses sent at this depth only pass the middlewares before it
+         auto&& respond = [this, &ctx, &sender](auto&& msg)
+         {
+            this->template unwind<I>(msg, ctx);
+            sender(std::move(msg));
+         };
+
+         return std::get<I>(stages_).before(req, ctx, respond) && before<I + 1>(req, ctx, sender);
+      }
+   }
+
+   template <std::size_t N, class Message>
+   void unwind(Message& msg, context_type& ctx)
+   {
+      if constexpr (N > 0)
+      {
+         std::get<N - 1>(stages_).after(msg, ctx);
+         unwind<N - 1>(msg, ctx);
+      }
+   }
+};
+
+//------------------------------------------------------------------------------
+
+// Tags every request with an ID, taken from the `X-Request-Id` request
+// header when the client sent one, and echoes it in the response.
+class request_id
+{
+   static constexpr char const* header = "X-Request-Id";
+
+public:
+   struct context
+   {
+      boost::beast::static_string<40> request_id;
+   };
+
+   template <class Request, class Context, class Respond>
+   bool before(Request& req, Context& ctx, Respond&)
+   {
+      auto const given = req[header];
+      if (!given.empty() && given.size() <= ctx.request_id.max_size())
+      {
+         ctx.request_id = given;
+         return true;
+      }
+
+      // The thread's ID in the high half keeps the counters apart
+      thread_local std::uint64_t next = std::hash<std::thread::id>{}(std::this_thread::get_id()) << 32;
+
+      char digits[16];
+      auto const end = std::to_chars(digits, digits + sizeof(digits), next++, 16).ptr;
+      ctx.request_id = boost::beast::string_view{digits, std::size_t(end - digits)};
+      return true;
+   }
+
+   template <class Message, class Context>
+   void after(Message& res, Context& ctx)
+   {
+      res.set(header, boost::beast::string_view{ctx.request_id.data(), ctx.request_id.size()});
+   }
+};
+
+//------------------------------------------------------------------------------
+
+// Writes `<method> <target> <status> <microseconds>` for every request.
+class access_log
+{
+   log_writer* writer_;
+
+public:
+   struct context
+   {
+      std::chrono::steady_clock::time_point started;
+      boost::beast::http::verb method;
+      boost::beast::static_string<128> target;
+   };
+
+   explicit access_log(log_writer& writer)
+      : writer_(&writer)
+   {
+   }
+
+   template <class Request, class Context, class Respond>
+   bool before(Request& req, Context& ctx, Respond&)
+   {
+      ctx.started = std::chrono::steady_clock::now();
+      ctx.method  = req.method();
+
+      auto const target = req.target();
+      ctx.target = target.substr(0, ctx.target.max_size());
+      return true;
+   }
+
+   template <class Message, class Context>
+   void after(Message& res, Context& ctx)
+   {
+      auto const now = std::chrono::steady_clock::now();
+      auto const us  = std::chrono::duration_cast<std::chrono::microseconds>(now - ctx.started).count();
+
+      char status[8];
+      char elapsed[24];
+      auto const status_end  = std::to_chars(status, status + sizeof(status), res.result_int()).ptr;
+      auto const elapsed_end = std::to_chars(elapsed, elapsed + sizeof(elapsed), us).ptr;
+
+      using boost::beast::string_view;
+      writer_->write_line(now,
+                          boost::beast::http::to_string(ctx.method),
+                          string_view{" "},
+                          string_view{ctx.target.data(), ctx.target.size()},
+                          string_view{" "},
+                          string_view{status, std::size_t(status_end - status)},
+                          string_view{" "},
+                          string_view{elapsed, std::size_t(elapsed_end - elapsed)},
+                          string_view{"us"});
+   }
+};
+
+//------------------------------------------------------------------------------
+
+// Answers CORS preflight requests and adds `Access-Control-Allow-Origin` to
+// responses for cross-origin requests from the allowed origin.
+class cors
+{
+   std::string origin_;
+   std::string methods_;
+   std::string headers_;
+
+public:
+   struct context
+   {
+      bool cross_origin = false;
+   };
+
+   // An `origin` of "*" allows every origin
+   explicit cors(std::string origin, std::string methods = "GET, POST, PUT, DELETE", std::string headers = "Content-Type")
+      : origin_(std::move(origin))
+      , methods_(std::move(methods))
+      , headers_(std::move(headers))
+   {
+   }
+
+   template <class Request, class Context, class Respond>
+   bool before(Request& req, Context& ctx, Respond& respond)
+   {
+      namespace http = boost::beast::http;
+
+      auto const origin = req[http::field::origin];
+      if (origin.empty() || (origin_ != "*" && origin != origin_))
+         return true;
+
+      ctx.cross_origin = true;
+
+      if (req.method() != http::verb::options || req[http::field::access_control_request_method].empty())
+         return true;
+
+      http::response<http::empty_body> res{http::status::no_content, req.version()};
+      res.set(http::field::access_control_allow_origin, origin_);
+      res.set(http::field::access_control_allow_methods, methods_);
+      res.set(http::field::access_control_allow_headers, headers_);
+      res.set(http::field::access_control_max_age, "86400");
+      if (origin_ != "*")
+         res.set(http::field::vary, "Origin");
+      res.keep_alive(req.keep_alive());
+      respond(std::move(res));
+      return false;
+   }
+
+   template <class Message, class Context>
+   void after(Message& res, Context& ctx)
+   {
+      namespace http = boost::beast::http;
+
+      if (!ctx.cross_origin)
+         return;
+
+      res.set(http::field::access_control_allow_origin, origin_);
+      if (origin_ != "*")
+         res.set(http::field::vary, "Origin");
+   }
+};
@@ -0,0 +1,705 @@
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/host_name_verification.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <boost/optional.hpp>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// How https upstreams are checked
+struct upstream_tls
+{
+   // Upstreams must present a certificate for their host name, issued by a
+   // trusted CA. Turning this off is for self-signed internal services.
+   bool verify = true;
+
+   // CA certificates trusted besides the system's, in a PEM file
+   std::string ca_file;
+};
+
+void fail(boost::system::error_code ec, char const* what);
+
+// A keep-alive connection to an upstream, plain or TLS
+class upstream_connection
+{
+   boost::asio::ip::tcp::socket socket_;
+   std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>> tls_;
+
+public:
+   boost::beast::flat_buffer buffer;
+
+   // Over TLS, `server_name` goes out as SNI unless it is an IP address
+   upstream_connection(boost::asio::io_context& ioc, boost::asio::ssl::context* tls, std::string const& server_name)
+      : socket_(ioc)
+   {
+      if (!tls)
+         return;
+
+      tls_ = std::make_unique<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>>(socket_, *tls);
+
+      boost::system::error_code ec;
+      boost::asio::ip::make_address(server_name, ec);
+      if (ec && !SSL_set_tlsext_host_name(tls_->native_handle(), server_name.c_str()))
+         fail(boost::system::error_code(static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()), "SNI");
+   }
+
+   boost::asio::ip::tcp::socket& socket()
+   {
+      return socket_;
+   }
+
+   bool is_tls() const
+   {
+      return tls_ != nullptr;
+   }
+
+   boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>& tls_stream()
+   {
+      return *tls_;
+   }
+
+   // Calls `f` with the stream HTTP messages are read from and written to
+   template <class F>
+   void with_stream(F&& f)
+   {
+      if (tls_)
+         f(*tls_);
+      else
+         f(socket_);
+   }
+
+   void close()
+   {
+      boost::system::error_code ec;
+      socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+      socket_.close(ec);
+   }
+};
+
+// One upstream server, with its idle connections and the number of
+// requests currently forwarded to it
+class upstream
+{
+   // Idle connections kept beyond this are closed
+   static constexpr std::size_t max_idle = 64;
+
+   std::mutex mutex_;
+   std::vector<std::unique_ptr<upstream_connection>> idle_;
+
+public:
+   // The Host header sent, and the name alone as sent in SNI
+   std::string const host;
+   std::string const server_name;
+   boost::asio::ip::tcp::resolver::results_type const endpoints;
+   std::shared_ptr<boost::asio::ssl::context> const tls;
+   std::atomic<int> outstanding{0};
+
+   upstream(std::string host, std::string server_name, boost::asio::ip::tcp::resolver::results_type endpoints, std::shared_ptr<boost::asio::ssl::context> tls)
+      : host(std::move(host))
+      , server_name(std::move(server_name))
+      , endpoints(std::move(endpoints))
+      , tls(std::move(tls))
+   {
+   }
+
+   // Returns an idle connection, or null if a new one must be opened
+   std::unique_ptr<upstream_connection> take_idle()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idle_.empty())
+         return nullptr;
+
+      auto conn = std::move(idle_.back());
+      idle_.pop_back();
+      return conn;
+   }
+
+   // Keeps a connection whose last exchange left it reusable
+   void give_back(std::unique_ptr<upstream_connection> conn)
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (idle_.size() < max_idle)
+         {
+            idle_.push_back(std::move(conn));
+            return;
+         }
+      }
+
+      conn->close();
+   }
+};
+
+//------------------------------------------------------------------------------
+
+// Drops the fields that only apply to one connection: Connection, those it
+// names, and the other hop-by-hop fields of RFC 7230
+template <bool isRequest, class Body, class Fields>
+void strip_hop_by_hop(boost::beast::http::message<isRequest, Body, Fields>& msg)
+{
+   namespace http = boost::beast::http;
+
+   for (auto const& token : http::token_list{msg[http::field::connection]})
+   {
+      if (!boost::beast::iequals(token, "connection"))
+         msg.erase(token);
+   }
+
+   for (auto const field : {http::field::connection,
+                            http::field::keep_alive,
+                            http::field::proxy_connection,
+                            http::field::proxy_authenticate,
+                            http::field::proxy_authorization,
+                            http::field::te,
+                            http::field::trailer,
+                            http::field::transfer_encoding,
+                            http::field::upgrade})
+      msg.erase(field);
+}
+
+// Readies the header `p` parsed to go on to the next hop, whose version and
+// persistence are given. This is prepare_payload() for a body relayed as it
+// arrives: a body keeps its length if it had one, otherwise it is chunked
+// on HTTP/1.1 and ended by closing the connection on HTTP/1.0.
+template <bool isRequest, class Body>
+void prepare_relayed(boost::beast::http::parser<isRequest, Body>& p, unsigned version, bool keep_alive)
+{
+   auto& msg = p.get();
+   strip_hop_by_hop(msg);
+   msg.erase(boost::beast::http::field::content_length);
+   msg.version(version);
+   msg.keep_alive(keep_alive);
+
+   if (auto const length = p.content_length())
+   {
+      msg.content_length(*length);
+   }
+   else if (p.chunked() || p.need_eof())
+   {
+      if (version == 11)
+         msg.chunked(true);
+      else
+         msg.keep_alive(false);
+   }
+}
+
+// Forwards one request to an upstream and streams the response back.
+//
+// Neither body is held in full: the request body is relayed from the client
+// as it is read, and the response body to the client as it arrives, a chunk
+// at a time, calling `progress` after each. The handler is called as
+//
+//    void(boost::system::error_code, std::shared_ptr<forward_op>)
+//
+// once the response header is in, or on failure. The caller then sends the
+// response with async_relay_response() once the client connection is free.
+// No deadline runs in between, as a pipelined response may wait behind a
+// slow one; an op dropped without being relayed lets its connection go.
+// Everything runs on the client session's executor, because the op reads
+// and writes the client's stream.
+template <class ClientStream, class Executor, class Handler>
+class forward_op : public std::enable_shared_from_this<forward_op<ClientStream, Executor, Handler>>
+{
+   using buffer_body = boost::beast::http::buffer_body;
+
+   // Bytes relayed per read and write
+   static constexpr std::size_t chunk_size = 16 * 1024;
+
+   boost::asio::io_context& ioc_;
+   upstream& upstream_;
+   ClientStream& client_;
+   boost::beast::flat_buffer& client_buffer_;
+   Executor executor_;
+   boost::asio::steady_timer timer_;
+   std::chrono::steady_clock::time_point deadline_;
+   std::chrono::steady_clock::duration idle_timeout_;
+   boost::beast::http::request_parser<buffer_body> req_;
+   boost::optional<boost::beast::http::request_serializer<buffer_body>> req_sr_;
+   boost::optional<boost::beast::http::response_parser<buffer_body>> res_;
+   boost::optional<boost::beast::http::response_serializer<buffer_body>> res_sr_;
+   std::unique_ptr<upstream_connection> conn_;
+   std::function<void()> progress_;
+   bool reused_ = false;
+   bool body_started_ = false;
+   bool request_relayed_ = false;
+   bool responded_ = false;
+   bool relaying_response_ = false;
+   bool timed_out_ = false;
+   bool done_ = false;
+   Handler handler_;
+   std::array<char, chunk_size> chunk_;
+
+public:
+   template <class Body>
+   forward_op(boost::asio::io_context& ioc, upstream& up, ClientStream& client, boost::beast::flat_buffer& client_buffer, boost::beast::http::request_parser<Body>&& req,
+              std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::duration idle_timeout, Executor const& executor, std::function<void()> progress,
+              Handler handler)
+      : ioc_(ioc)
+      , upstream_(up)
+      , client_(client)
+      , client_buffer_(client_buffer)
+      , executor_(executor)
+      , timer_(ioc)
+      , deadline_(deadline)
+      , idle_timeout_(idle_timeout)
+      , req_(std::move(req))
+      , progress_(std::move(progress))
+      , handler_(std::move(handler))
+   {
+      // The upstream connection outlives this request
+      prepare_relayed(req_, 11, true);
+      req_.get().set(boost::beast::http::field::host, upstream_.host);
+      req_.body_limit(std::numeric_limits<std::uint64_t>::max());
+   }
+
+   ~forward_op()
+   {
+      finish(false);
+   }
+
+   // The response header, once the handler has been called without error
+   boost::beast::http::response<buffer_body>& response()
+   {
+      return res_->get();
+   }
+
+   // Returns `true` once the whole request was read from the client, which
+   // can then send its next one
+   bool request_relayed() const
+   {
+      return request_relayed_;
+   }
+
+   // Readies the response header for a client with this version and
+   // persistence
+   void prepare_response(unsigned version, bool keep_alive)
+   {
+      prepare_relayed(*res_, version, keep_alive);
+   }
+
+   void run()
+   {
+      ++upstream_.outstanding;
+      arm_timer();
+
+      boost::asio::dispatch(boost::asio::bind_executor(executor_, [self = this->shared_from_this()]() { self->start(); }));
+   }
+
+   // Writes the response to the client, relaying the body as it arrives.
+   // The handler is called as void(boost::system::error_code).
+   template <class RelayHandler>
+   void async_relay_response(RelayHandler&& handler)
+   {
+      // Nothing is sent for a response that can no longer be relayed
+      if (done_)
+      {
+         return boost::asio::post(boost::asio::bind_executor(executor_, [handler = std::forward<RelayHandler>(handler)]() mutable {
+            handler(boost::asio::error::timed_out);
+         }));
+      }
+
+      relaying_response_ = true;
+      deadline_ = std::chrono::steady_clock::now() + idle_timeout_;
+      arm_timer();
+      res_sr_.emplace(res_->get());
+
+      auto&& on_body = [ self = this->shared_from_this(), handler = std::forward<RelayHandler>(handler) ](auto ec) mutable
+      {
+         self->finish(!ec && self->res_->is_done() && self->res_->keep_alive());
+         handler(ec);
+      };
+
+      conn_->with_stream([&](auto& stream) {
+         relay_message(stream, conn_->buffer, *res_, client_, *res_sr_, std::move(on_body));
+      });
+   }
+
+private:
+   // The deadline only moves forward, so the timer is re-armed rather than
+   // cancelled whenever it changes
+   void arm_timer()
+   {
+      timer_.expires_at(deadline_);
+
+      auto&& on_timeout = [self = this->shared_from_this()](auto ec)
+      {
+         // The timer is only cancelled when the deadline stops: once the op
+         // is done, and while the response waits for the client
+         if (ec == boost::asio::error::operation_aborted || self->done_)
+            return;
+
+         if (std::chrono::steady_clock::now() < self->deadline_)
+            return self->arm_timer();
+
+         // Closing the connection fails whatever operation is pending
+         self->timed_out_ = true;
+         if (self->conn_)
+            self->conn_->close();
+
+         // A response that is partly sent cannot be finished
+         if (self->relaying_response_)
+         {
+            boost::system::error_code ignored;
+            self->client_.lowest_layer().close(ignored);
+         }
+      };
+
+      timer_.async_wait(boost::asio::bind_executor(executor_, std::move(on_timeout)));
+   }
+
+   void start()
+   {
+      // The deadline may already have passed
+      if (timed_out_)
+         return fail(boost::asio::error::timed_out);
+
+      conn_ = upstream_.take_idle();
+      reused_ = conn_ != nullptr;
+      if (reused_)
+         return schedule_write();
+
+      schedule_connect();
+   }
+
+   void schedule_connect()
+   {
+      conn_ = std::make_unique<upstream_connection>(ioc_, upstream_.tls.get(), upstream_.server_name);
+
+      auto&& on_connect = [self = this->shared_from_this()](auto ec, auto const&)
+      {
+         if (ec)
+            return self->fail(ec);
+
+         self->conn_->socket().set_option(boost::asio::ip::tcp::no_delay(true), ec);
+         if (ec)
+            ::fail(ec, "TCP_NODELAY");
+
+         if (!self->conn_->is_tls())
+            return self->schedule_write();
+
+         auto&& on_handshake = [self](auto ec)
+         {
+            if (ec)
+               return self->fail(ec);
+
+            self->schedule_write();
+         };
+
+         self->conn_->tls_stream().async_handshake(boost::asio::ssl::stream_base::client, boost::asio::bind_executor(self->executor_, std::move(on_handshake)));
+      };
+
+      boost::asio::async_connect(conn_->socket(), upstream_.endpoints, boost::asio::bind_executor(executor_, std::move(on_connect)));
+   }
+
+   void schedule_write()
+   {
+      req_sr_.emplace(req_.get());
+
+      auto&& on_request = [self = this->shared_from_this()](auto ec)
+      {
+         if (ec)
+            return self->retry_or_fail(ec);
+
+         self->request_relayed_ = true;
+         self->schedule_read();
+      };
+
+      conn_->with_stream([&](auto& stream) {
+         relay_message(client_, client_buffer_, req_, stream, *req_sr_, std::move(on_request));
+      });
+   }
+
+   void schedule_read()
+   {
+      res_.emplace();
+      res_->body_limit(std::numeric_limits<std::uint64_t>::max());
+      res_->skip(req_.get().method() == boost::beast::http::verb::head);
+
+      auto&& on_header = [self = this->shared_from_this()](auto ec, std::size_t)
+      {
+         if (ec)
+            return self->retry_or_fail(ec);
+
+         // Interim responses, such as 100 Continue, are not passed on
+         if (self->res_->get().result_int() / 100 == 1)
+            return self->schedule_read();
+
+         self->responded_ = true;
+
+         boost::system::error_code ignored;
+         self->timer_.cancel(ignored);
+         self->complete({});
+      };
+
+      conn_->with_stream([&](auto& stream) {
+         boost::beast::http::async_read_header(stream, conn_->buffer, *res_, boost::asio::bind_executor(executor_, std::move(on_header)));
+      });
+   }
+
+   // Sends the message whose header `p` has parsed through `sr`, then
+   // relays its body. The header goes out with the first chunk when that is
+   // already at hand, which saves a write, and otherwise on its own, so the
+   // peer sees it without waiting for the body.
+   template <class Input, class Output, bool isRequest, class Next>
+   void relay_message(Input& input, boost::beast::flat_buffer& buffer, boost::beast::http::parser<isRequest, buffer_body>& p, Output& output,
+                      boost::beast::http::serializer<isRequest, buffer_body>& sr, Next&& next)
+   {
+      if (p.is_done() || buffer.size() > 0)
+         return relay(input, buffer, p, output, sr, std::forward<Next>(next));
+
+      auto&& on_header = [ self = this->shared_from_this(), &input, &buffer, &p, &output, &sr, next = std::forward<Next>(next) ](auto ec, std::size_t) mutable
+      {
+         if (ec)
+            return next(ec);
+
+         self->relay(input, buffer, p, output, sr, std::move(next));
+      };
+
+      boost::beast::http::async_write_header(output, sr, boost::asio::bind_executor(executor_, std::move(on_header)));
+   }
+
+   // Moves the rest of the body `p` is parsing from `input` to `output`, one
+   // chunk at a time, through `sr`, which serializes the same message. Calls
+   // `next(ec)` once the whole message is through.
+   template <class Input, class Output, bool isRequest, class Next>
+   void relay(Input& input, boost::beast::flat_buffer& buffer, boost::beast::http::parser<isRequest, buffer_body>& p, Output& output,
+              boost::beast::http::serializer<isRequest, buffer_body>& sr, Next&& next)
+   {
+      auto& body = p.get().body();
+      if (p.is_done())
+      {
+         body.data = nullptr;
+         body.size = 0;
+         body.more = false;
+         return relay_write(input, buffer, p, output, sr, std::forward<Next>(next));
+      }
+
+      body.data = chunk_.data();
+      body.size = chunk_.size();
+
+      // Body bytes read from the client cannot be read again
+      if (isRequest)
+         body_started_ = true;
+
+      auto&& on_read = [ self = this->shared_from_this(), &input, &buffer, &p, &output, &sr, next = std::forward<Next>(next) ](auto ec, std::size_t) mutable
+      {
+         // The chunk is full
+         if (ec == boost::beast::http::error::need_buffer)
+            ec = {};
+         if (ec)
+            return next(ec);
+
+         // Framing alone, such as a chunk header, yields no body. An empty
+         // buffer would be serialized as the last chunk, so read on.
+         auto const n = self->chunk_.size() - p.get().body().size;
+         if (n == 0 && !p.is_done())
+            return self->relay(input, buffer, p, output, sr, std::move(next));
+
+         auto& body = p.get().body();
+         body.data  = n == 0 ? nullptr : self->chunk_.data();
+         body.size  = n;
+         body.more  = !p.is_done();
+
+         self->relay_write(input, buffer, p, output, sr, std::move(next));
+      };
+
+      // Whatever has arrived is passed on, so slow streams are not held back
+      boost::beast::http::async_read_some(input, buffer, p, boost::asio::bind_executor(executor_, std::move(on_read)));
+   }
+
+   template <class Input, class Output, bool isRequest, class Next>
+   void relay_write(Input& input, boost::beast::flat_buffer& buffer, boost::beast::http::parser<isRequest, buffer_body>& p, Output& output,
+                    boost::beast::http::serializer<isRequest, buffer_body>& sr, Next&& next)
+   {
+      auto&& on_write = [ self = this->shared_from_this(), &input, &buffer, &p, &output, &sr, next = std::forward<Next>(next) ](auto ec, std::size_t) mutable
+      {
+         // The chunk was written
+         if (ec == boost::beast::http::error::need_buffer)
+            ec = {};
+         if (ec)
+            return next(ec);
+
+         self->deadline_ = std::chrono::steady_clock::now() + self->idle_timeout_;
+         if (self->progress_)
+            self->progress_();
+
+         if (p.is_done() || sr.is_done())
+            return next(ec);
+
+         self->relay(input, buffer, p, output, sr, std::move(next));
+      };
+
+      boost::beast::http::async_write(output, sr, boost::asio::bind_executor(executor_, std::move(on_write)));
+   }
+
+   // An idle connection may have been closed by the upstream in the
+   // meantime, so a request that failed on a reused one is sent once more
+   // on a new connection, provided no body was read from the client and
+   // nothing of the response arrived
+   void retry_or_fail(boost::system::error_code ec)
+   {
+      if (!reused_ || timed_out_ || body_started_ || (res_ && res_->got_some()))
+         return fail(ec);
+
+      conn_->close();
+      res_.reset();
+      reused_ = false;
+
+      schedule_connect();
+   }
+
+   void fail(boost::system::error_code ec)
+   {
+      if (timed_out_)
+         ec = boost::asio::error::timed_out;
+
+      finish(false);
+      complete(ec);
+   }
+
+   // The handler is let go once called, as it holds on to the session
+   void complete(boost::system::error_code ec)
+   {
+      auto handler = std::move(handler_);
+      handler(ec, this->shared_from_this());
+   }
+
+   // Ends the exchange with the upstream, keeping the connection if it is
+   // still in a state to be reused
+   void finish(bool reusable)
+   {
+      if (done_)
+         return;
+      done_ = true;
+
+      boost::system::error_code ignored;
+      timer_.cancel(ignored);
+      --upstream_.outstanding;
+
+      // The deadline closes the connection, even if the response completed.
+      // So do bytes past the response, such as a body sent with a HEAD
+      // response, as the next response would not parse.
+      if (reusable && !timed_out_ && conn_->buffer.size() == 0)
+         upstream_.give_back(std::move(conn_));
+
+      if (conn_)
+         conn_->close();
+
+      progress_ = nullptr;
+   }
+};
+
+//------------------------------------------------------------------------------
+
+// Forwards requests whose target starts with a prefix to a set of upstream
+// servers over pooled keep-alive connections, streaming both bodies. Each
+// request goes to the upstream with the fewest requests in flight.
+class proxy
+{
+   boost::asio::io_context& ioc_;
+   std::string prefix_;
+   std::vector<std::unique_ptr<upstream>> upstreams_;
+   std::chrono::seconds timeout_;
+   std::atomic<std::size_t> next_{0};
+
+public:
+   proxy(boost::asio::io_context& ioc, std::string prefix, std::chrono::seconds timeout)
+      : ioc_(ioc)
+      , prefix_(std::move(prefix))
+      , timeout_(timeout)
+   {
+   }
+
+   // Adds an upstream given as `http://host:port` or `https://host:port`.
+   // Throws if it cannot be resolved or the CA file cannot be read.
+   void add_upstream(std::string const& url, upstream_tls const& options = {})
+   {
+      auto const scheme_end = url.find("://");
+      auto const scheme     = scheme_end == std::string::npos ? std::string{"http"} : url.substr(0, scheme_end);
+      auto const authority  = scheme_end == std::string::npos ? url : url.substr(scheme_end + 3);
+      auto const colon      = authority.rfind(':');
+      auto const host       = authority.substr(0, colon);
+      auto const port       = colon == std::string::npos ? (scheme == "https" ? "443" : "80") : authority.substr(colon + 1);
+
+      // Bracketed IPv6 addresses are verified without the brackets
+      auto const server_name = host.size() > 1 && host.front() == '[' && host.back() == ']' ? host.substr(1, host.size() - 2) : host;
+
+      std::shared_ptr<boost::asio::ssl::context> tls;
+      if (scheme == "https")
+      {
+         tls = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_client);
+         if (options.verify)
+         {
+            tls->set_default_verify_paths();
+            if (!options.ca_file.empty())
+               tls->load_verify_file(options.ca_file);
+            tls->set_verify_mode(boost::asio::ssl::verify_peer);
+            tls->set_verify_callback(boost::asio::ssl::host_name_verification(server_name));
+         }
+      }
+
+      boost::asio::ip::tcp::resolver resolver{ioc_};
+      upstreams_.push_back(std::make_unique<upstream>(authority, server_name, resolver.resolve(server_name, port), std::move(tls)));
+   }
+
+   // Returns `true` if requests for this target are forwarded
+   bool matches(boost::beast::string_view target) const
+   {
+      return !upstreams_.empty() && target.substr(0, prefix_.size()) == prefix_;
+   }
+
+   // Forwards a request whose header `req` has parsed from `client`, with
+   // `client_buffer` holding what was read past it. The parser must not
+   // have started on the body, which is relayed from there. Gives up waiting for the
+   // response at the earlier of `deadline` and the proxy's own timeout, and
+   // on a body that stalls for that timeout. See forward_op for `progress`
+   // and the handler.
+   template <class ClientStream, class Body, class Executor, class Handler>
+   void async_forward(ClientStream& client, boost::beast::flat_buffer& client_buffer, boost::beast::http::request_parser<Body>&& req,
+                      std::chrono::steady_clock::time_point deadline, Executor const& executor, std::function<void()> progress, Handler&& handler)
+   {
+      // Ties go round-robin, so an idle proxy still spreads the load
+      auto const n     = upstreams_.size();
+      auto const first = next_.fetch_add(1, std::memory_order_relaxed) % n;
+
+      auto* best = upstreams_[first].get();
+      for (std::size_t i = 1; i < n; ++i)
+      {
+         auto* up = upstreams_[(first + i) % n].get();
+         if (up->outstanding.load(std::memory_order_relaxed) < best->outstanding.load(std::memory_order_relaxed))
+            best = up;
+      }
+
+      deadline = std::min(deadline, std::chrono::steady_clock::now() + timeout_);
+
+      using op_type = forward_op<ClientStream, Executor, std::decay_t<Handler>>;
+      std::make_shared<op_type>(ioc_, *best, client, client_buffer, std::move(req), deadline, timeout_, executor, std::move(progress), std::forward<Handler>(handler))->run();
+   }
+};
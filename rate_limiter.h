@@ -0,0 +1,244 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/beast/core/string.hpp>
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Limits to a steady rate, allowing bursts of up to `burst` requests. The
+// rate must be above zero, and a full burst must refill within about 30
+// years.
+struct rate_limit
+{
+   double per_second;
+   unsigned burst;
+};
+
+// Token buckets per client, and per client and route, kept in a fixed table
+// of atomics.
+//
+// A bucket is stored as the time at which it would be full again (the
+// "virtual scheduling" form of a token bucket), so refilling happens lazily
+// when a request arrives and taking a token is one compare-and-swap. Keys are
+// hashed straight to a slot and not stored: clients that collide share a
+// bucket, which can only make their limit stricter.
+class rate_limiter
+{
+   // Longest Retry-After that is sent, in seconds
+   static constexpr unsigned max_retry_after = 60;
+
+   struct rule
+   {
+      std::string prefix;
+      std::uint64_t interval;    // nanoseconds per token
+      std::uint64_t tolerance;   // nanoseconds of burst
+   };
+
+   // rules_[0] applies to every request, the rest to their route
+   std::vector<rule> rules_;
+   std::unique_ptr<std::atomic<std::uint64_t>[]> slots_;
+   std::size_t mask_;
+   std::vector<std::string> rejections_;
+   std::vector<boost::asio::ip::address> exempt_;
+
+   static rule make_rule(std::string prefix, rate_limit limit)
+   {
+      auto const burst = std::max(limit.burst, 1u);
+      if (!(limit.per_second > 0))
+         throw std::invalid_argument("rate_limit: the rate must be above zero");
+
+      // Keeps the burst, in nanoseconds, well inside 64 bits
+      if (1e9 / limit.per_second * burst > 1e18)
+         throw std::invalid_argument("rate_limit: the burst takes too long to refill at this rate");
+
+      auto const interval = static_cast<std::uint64_t>(1e9 / limit.per_second);
+      return {std::move(prefix), interval, interval * burst};
+   }
+
+   // A dual-stack socket reports IPv4 clients as ::ffff:a.b.c.d, which is
+   // the same client as a.b.c.d
+   static boost::asio::ip::address unmapped(boost::asio::ip::address const& address)
+   {
+      if (address.is_v6() && address.to_v6().is_v4_mapped())
+         return boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, address.to_v6());
+      return address;
+   }
+
+   static std::uint64_t mix(std::uint64_t x)
+   {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ull;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebull;
+      x ^= x >> 31;
+      return x;
+   }
+
+   // The coarse clock ticks every few milliseconds, which is fine for
+   // refilling buckets, and is much cheaper to read than steady_clock
+   static std::uint64_t now_ns()
+   {
+#if defined(CLOCK_MONOTONIC_COARSE)
+      timespec ts;
+      ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+      return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+   }
+
+   // Takes a token from the bucket. Returns 0 on success, otherwise the
+   // nanoseconds until a token will be available. A failed take leaves the
+   // bucket as it was.
+   static std::uint64_t take(std::atomic<std::uint64_t>& slot, std::uint64_t now, rule const& r)
+   {
+      auto full_at = slot.load(std::memory_order_relaxed);
+      for (;;)
+      {
+         auto const next = std::max(full_at, now) + r.interval;
+         if (next - now > r.tolerance)
+            return next - now - r.tolerance;
+
+         if (slot.compare_exchange_weak(full_at, next, std::memory_order_relaxed))
+            return 0;
+      }
+   }
+
+   // Puts back a token taken from the bucket
+   static void refund(std::atomic<std::uint64_t>& slot, rule const& r)
+   {
+      slot.fetch_sub(r.interval, std::memory_order_relaxed);
+   }
+
+   // The serialized 429 for a wait of `seconds`, an HTTP version and whether
+   // the connection closes after it
+   static std::size_t rejection_index(std::uint64_t seconds, bool http10, bool close)
+   {
+      return seconds * 4 + http10 * 2 + close;
+   }
+
+public:
+   // `slots` is rounded up to a power of two. Throws std::invalid_argument
+   // for a limit that validate() rejects, as does add_route().
+   explicit rate_limiter(rate_limit per_client, std::size_t slots = 1 << 18)
+   {
+      std::size_t size = 1;
+      while (size < slots)
+         size <<= 1;
+
+      slots_.reset(new std::atomic<std::uint64_t>[size]);
+      for (std::size_t i = 0; i < size; ++i)
+         slots_[i].store(0, std::memory_order_relaxed);
+      mask_ = size - 1;
+
+      rules_.push_back(make_rule({}, per_client));
+
+      // HTTP/1.1 connections persist unless told otherwise, HTTP/1.0 ones
+      // close unless told otherwise
+      for (unsigned s = 0; s <= max_retry_after; ++s)
+      {
+         for (bool http10 : {false, true})
+         {
+            for (bool close : {false, true})
+            {
+               auto const connection = http10 ? (close ? "" : "Connection: keep-alive\r\n") : (close ? "Connection: close\r\n" : "");
+
+               rejections_.push_back(std::string{http10 ? "HTTP/1.0" : "HTTP/1.1"} + " 429 Too Many Requests\r\n"
+                                     "Retry-After: " + std::to_string(std::max(s, 1u)) + "\r\n"
+                                     + connection +
+                                     "Content-Length: 0\r\n"
+                                     "\r\n");
+            }
+         }
+      }
+   }
+
+   // Throws std::invalid_argument, saying why, for a limit that cannot be
+   // used
+   static void validate(rate_limit limit)
+   {
+      make_rule({}, limit);
+   }
+
+   // Adds a limit for each client on targets starting with `prefix`. The
+   // longest matching prefix applies. Not safe once requests are admitted.
+   void add_route(std::string prefix, rate_limit limit)
+   {
+      rules_.push_back(make_rule(std::move(prefix), limit));
+   }
+
+   // Lets clients at `address` through without any limit. Not safe once
+   // requests are admitted.
+   void exempt(boost::asio::ip::address const& address)
+   {
+      exempt_.push_back(unmapped(address));
+   }
+
+   // Whether clients at `address` are exempt. Checked once per connection.
+   bool is_exempt(boost::asio::ip::address const& address) const
+   {
+      return std::find(exempt_.begin(), exempt_.end(), unmapped(address)) != exempt_.end();
+   }
+
+   // Folds a client address into a key for admit()
+   static std::uint64_t key_of(boost::asio::ip::address const& given)
+   {
+      auto const address = unmapped(given);
+      if (address.is_v4())
+         return address.to_v4().to_uint();
+
+      std::uint64_t key = 0;
+      for (auto byte : address.to_v6().to_bytes())
+         key = (key << 8 | byte) ^ (key >> 56);
+      return mix(key);
+   }
+
+   // Returns 0 if the request may proceed, otherwise the nanoseconds the
+   // client should wait. A request is charged only if it is admitted: one
+   // turned away by its route's limit gives the client's token back.
+   std::uint64_t admit(std::uint64_t client, boost::beast::string_view target)
+   {
+      auto const now = now_ns();
+
+      auto& client_slot = slots_[mix(client) & mask_];
+      if (auto const wait = take(client_slot, now, rules_[0]))
+         return wait;
+
+      std::size_t route = 0;
+      for (std::size_t i = 1; i < rules_.size(); ++i)
+      {
+         auto const& prefix = rules_[i].prefix;
+         if (target.substr(0, prefix.size()) == prefix && (route == 0 || prefix.size() > rules_[route].prefix.size()))
+            route = i;
+      }
+
+      if (route == 0)
+         return 0;
+
+      auto const wait = take(slots_[mix(client ^ mix(route)) & mask_], now, rules_[route]);
+      if (wait)
+         refund(client_slot, rules_[0]);
+      return wait;
+   }
+
+   // A serialized 429 response telling the client to wait `wait` nanoseconds,
+   // in the request's HTTP `version`, and saying whether the connection will
+   // `close` after it
+   boost::asio::const_buffer rejection(std::uint64_t wait, unsigned version, bool close) const
+   {
+      auto const seconds = std::min<std::uint64_t>((wait + 999999999) / 1000000000, max_retry_after);
+      auto const& bytes  = rejections_[rejection_index(seconds, version < 11, close)];
+      return boost::asio::buffer(bytes.data(), bytes.size());
+   }
+};
@@ -5,24 +5,39 @@
 
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
 
 #include <boost/config.hpp>
+#include <boost/optional.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "buffer_pool.h"
+#include "endpoint.h"
+#include "io_backend.h"
+#include "middleware.h"
+#include "proxy.h"
+#include "rate_limiter.h"
+#include "server_options.h"
+
 using tcp           = boost::asio::ip::tcp;      // from <boost/asio/ip/tcp.hpp>
+namespace local     = boost::asio::local;        // from <boost/asio/local/stream_protocol.hpp>
 namespace http      = boost::beast::http;        // from <boost/beast/http.hpp>
 namespace websocket = boost::beast::websocket;   // from <boost/beast/websocket.hpp>
 
@@ -30,15 +45,17 @@ namespace websocket = boost::beast::websocket;   // from <boost/beast/websocket.
 // request. The type of the response object depends on the
 // contents of the request, so the interface requires the
 // caller to pass a generic lambda for receiving the response.
-template <class Body, class Allocator, class Sender>
-void handle_request(http::request<Body, http::basic_fields<Allocator>>&& req, Sender& sender)
+// The context carries what the middlewares attached to the request.
+template <class Body, class Allocator, class Context, class Sender>
+void handle_request(http::request<Body, http::basic_fields<Allocator>>&& req, Context const& ctx, Sender& sender)
 {
    // Build the path to the requested file
    auto&& tgt = req.target();
    std::string path{tgt.begin(), tgt.end()};
 
    std::ostringstream oss;
-   oss << "{\"method\":\"GET\", \"data\":\"Hello! World\", \"path\": " << std::quoted(path) << "}\r\n";
+   oss << "{\"method\":\"GET\", \"data\":\"Hello! World\", \"path\": " << std::quoted(path)
+       << ", \"id\": " << std::quoted(std::string{ctx.request_id.data(), ctx.request_id.size()}) << "}\r\n";
 
    http::response<http::string_body> res{http::status::ok, req.version()};
    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
@@ -58,9 +75,28 @@ void fail(boost::system::error_code ec, char const* what)
    std::cerr << what << ": " << ec.message() << "\n";
 }
 
+// Hooks that run around handle_request, outermost first
+using pipeline = middleware_chain<request_id, access_log, cors>;
+
 
-class http_session : public std::enable_shared_from_this<http_session>
+// Serves HTTP over a connected socket, TCP or Unix domain
+template <class Socket>
+class http_session : public std::enable_shared_from_this<http_session<Socket>>
 {
+   // A response that is already serialized, such as a 429 from the limiter
+   struct canned_response
+   {
+      boost::asio::const_buffer bytes;
+      bool close;
+   };
+
+   // A response relayed from an upstream as it arrives
+   template <class Op>
+   struct proxied_response
+   {
+      std::shared_ptr<Op> op;
+   };
+
    // This queue is used for HTTP pipelining.
    class queue
    {
@@ -69,11 +105,11 @@ class http_session : public std::enable_shared_from_this<http_session>
       std::vector<std::function<void()>> items_;
 
    public:
+      // Slots are allocated on first use, so idle sessions hold none
       explicit queue(http_session* owner, int limit)
          : owner_(owner)
          , limit_(limit)
       {
-         items_.reserve(limit_);
       }
 
       // Returns `true` if we have reached the queue limit
@@ -82,6 +118,12 @@ class http_session : public std::enable_shared_from_this<http_session>
          return items_.size() >= limit_;
       }
 
+      // Returns `true` if nothing is waiting to be sent
+      bool is_empty() const
+      {
+         return items_.empty();
+      }
+
       // Called when a message finishes sending
       // Returns `true` if the caller should initiate a read
       bool next_task()
@@ -95,6 +137,13 @@ class http_session : public std::enable_shared_from_this<http_session>
          return was_full;
       }
 
+      // Gives back the slots while the session is idle
+      void shrink()
+      {
+         if (items_.empty())
+            items_.shrink_to_fit();
+      }
+
       // Called by the HTTP handler to send a response.
       template <class M>
       void operator()(M&& msg)
@@ -111,23 +160,45 @@ class http_session : public std::enable_shared_from_this<http_session>
       }
    };
 
-   tcp::socket socket_;
-   boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+   Socket socket_;
+   boost::asio::strand<typename Socket::executor_type> strand_;
    boost::asio::steady_timer timer_;
    boost::beast::flat_buffer buffer_;
    http::request<http::string_body> req_;
+   boost::optional<http::request_parser<http::string_body>> parser_;
    queue queue_;
+   std::shared_ptr<pipeline> pipeline_;
+   proxy* proxy_;
+   rate_limiter* limiter_;
+   std::uint64_t client_key_;
    std::chrono::seconds timeout_;
 
+   // Largest request body read into memory, as for http::async_read
+   static constexpr std::uint64_t body_limit = 1024 * 1024;
+
+   // Sent for proxied requests that expect it, ahead of reading the body
+   static constexpr char continue_response[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
 public:
    // Take ownership of the socket
-   explicit http_session(tcp::socket&& socket)
+   explicit http_session(Socket&& socket, std::shared_ptr<pipeline> hooks, std::shared_ptr<proxy> routes, std::shared_ptr<rate_limiter> limits)
       : socket_(std::move(socket))
       , strand_(socket_.get_executor())
-      , timer_(socket_.get_executor().context(), std::chrono::steady_clock::time_point::max())
+      , timer_(timer_context(socket_), std::chrono::steady_clock::time_point::max())
       , queue_(this, 10)
+      , pipeline_(std::move(hooks))
+      , proxy_(routes.get())
+      , limiter_(nullptr)
+      , client_key_(0)
       , timeout_(15)
    {
+      // Unix domain peers have no address, and are not limited
+      auto const peer = peer_address(socket_);
+      if (limits && peer && !limits->is_exempt(*peer))
+      {
+         limiter_    = limits.get();
+         client_key_ = rate_limiter::key_of(*peer);
+      }
    }
 
    // Start the asynchronous operation
@@ -136,7 +207,7 @@ public:
       // Make sure we run on the strand
       if (!strand_.running_in_this_thread())
       {
-         return boost::asio::post(boost::asio::bind_executor(strand_, [self = shared_from_this()]() { self->run(); }));
+         return boost::asio::post(boost::asio::bind_executor(strand_, [self = this->shared_from_this()]() { self->run(); }));
       }
 
 
@@ -147,7 +218,7 @@ public:
 
    void arm_timer()
    {
-      auto&& on_timeout = [self = shared_from_this()](auto ec)
+      auto&& on_timeout = [self = this->shared_from_this()](auto ec)
       {
          if (ec && ec != boost::asio::error::operation_aborted)
             return fail(ec, "timer");
@@ -174,81 +245,325 @@ public:
       // otherwise the operation behavior is undefined.
       req_ = {};
 
-      auto&& on_read = [self = shared_from_this()](auto ec, std::size_t)
+      // Nothing of the next request has arrived yet, so the session is
+      // idle. Hand the buffers back and wait for the peer before reading.
+      if (buffer_.size() == 0)
+         return schedule_idle_wait();
+
+      do_read();
+   }
+
+   void schedule_idle_wait()
+   {
+      buffer_pool::release(std::move(buffer_));
+      queue_.shrink();
+
+      auto&& on_ready = [self = this->shared_from_this()](auto ec)
       {
          // Happens when the timer closes the socket
          if (ec == boost::asio::error::operation_aborted)
             return;
 
-         // This means they closed the connection
-         if (ec == http::error::end_of_stream)
-            return self->do_close();
          if (ec)
-            return fail(ec, "read");
+            return fail(ec, "wait");
 
-         // See if it is a WebSocket Upgrade
-         if (websocket::is_upgrade(self->req_))
-         {
-            // ignore websockets
-            self->do_close();
-            return;
-         }
+         self->buffer_ = buffer_pool::acquire();
+         self->do_read();
+      };
 
-         // Send the response
-         handle_request(std::move(self->req_), self->queue_);
+      // Wait without a buffer until there is something to read
+      socket_.async_wait(Socket::wait_read, boost::asio::bind_executor(strand_, std::move(on_ready)));
+   }
 
-         // If we aren't at the queue limit, try to process another request
-         if (!self->queue_.is_full())
-            self->schedule_read();
+   void do_read()
+   {
+      // With a proxy route, the header decides where the body goes
+      if (proxy_)
+         return do_read_header();
+
+      auto&& on_read = [self = this->shared_from_this()](auto ec, std::size_t)
+      {
+         if (self->read_succeeded(ec))
+            self->on_request();
       };
 
       // Read a request
       http::async_read(socket_, buffer_, req_, boost::asio::bind_executor(strand_, std::move(on_read)));
    }
 
-
-   template <bool isRequest, class Body, class Fields>
-   void schedule_write(http::message<isRequest, Body, Fields>& msg)
+   void do_read_header()
    {
-      auto&& on_write = [ self = shared_from_this(), close = msg.need_eof() ](auto ec, auto sz)
+      // Proxied bodies are relayed, not held, so they have no limit
+      parser_.emplace();
+      parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+
+      auto&& on_header = [self = this->shared_from_this()](auto ec, std::size_t)
       {
-         // Happens when the timer closes the socket
-         if (ec == boost::asio::error::operation_aborted)
+         if (!self->read_succeeded(ec))
             return;
 
-         if (ec)
-            return fail(ec, "write");
+         // Requests under the proxy route are answered by an upstream
+         if (self->proxy_->matches(self->parser_->get().target()))
+            return self->schedule_forward();
+
+         if (self->parser_->is_done())
+            return self->on_parsed();
 
-         if (close)
+         // The limit http::async_read applies to the requests served here
+         auto const length = self->parser_->content_length();
+         if (length && *length > body_limit)
+            return fail(http::error::body_limit, "read");
+         self->parser_->body_limit(body_limit);
+
+         auto&& on_body = [self](auto ec, std::size_t)
          {
-            // This means we should close the connection, usually because
-            // the response indicated the "Connection: close" semantic.
-            return self->do_close();
+            if (self->read_succeeded(ec))
+               self->on_parsed();
+         };
+
+         http::async_read(self->socket_, self->buffer_, *self->parser_, boost::asio::bind_executor(self->strand_, std::move(on_body)));
+      };
+
+      http::async_read_header(socket_, buffer_, *parser_, boost::asio::bind_executor(strand_, std::move(on_header)));
+   }
+
+   bool read_succeeded(boost::system::error_code ec)
+   {
+      // Happens when the timer closes the socket
+      if (ec == boost::asio::error::operation_aborted)
+         return false;
+
+      // This means they closed the connection
+      if (ec == http::error::end_of_stream)
+      {
+         do_close();
+         return false;
+      }
+
+      if (ec)
+      {
+         fail(ec, "read");
+         return false;
+      }
+
+      return true;
+   }
+
+   void on_parsed()
+   {
+      req_ = parser_->release();
+      parser_.reset();
+      on_request();
+   }
+
+   void on_request()
+   {
+      if (!screen(req_, false))
+         return;
+
+      // Send the response
+      (*pipeline_)(
+         std::move(req_),
+         [](auto&& req, auto const& ctx, auto& sender) { handle_request(std::move(req), ctx, sender); },
+         queue_);
+
+      // If we aren't at the queue limit, try to process another request
+      if (!queue_.is_full())
+         schedule_read();
+   }
+
+   // Turns away WebSocket upgrades, and clients over their limit with a
+   // canned 429. Returns `true` if the request may go on. A request whose
+   // body is still unread ends the connection, as the next one cannot be
+   // found.
+   template <class Request>
+   bool screen(Request const& req, bool body_unread)
+   {
+      // See if it is a WebSocket Upgrade
+      if (websocket::is_upgrade(req))
+      {
+         // ignore websockets
+         do_close();
+         return false;
+      }
+
+      // Clients over their limit get a canned 429 and nothing else
+      if (limiter_)
+      {
+         if (auto const wait = limiter_->admit(client_key_, req.target()))
+         {
+            auto const close = body_unread || !req.keep_alive();
+            queue_(canned_response{limiter_->rejection(wait, req.version(), close), close});
+
+            if (!body_unread && !queue_.is_full())
+               schedule_read();
+            return false;
          }
+      }
+
+      return true;
+   }
+
+   // Relays the request whose header is in `parser_` to an upstream, and its
+   // response back, running the middlewares around them. The access log
+   // then times a proxied request up to the response header.
+   void schedule_forward()
+   {
+      auto& req              = parser_->get();
+      auto const body_unread = !parser_->is_done();
+
+      if (!screen(req, body_unread))
+         return;
+
+      auto const version    = req.version();
+      auto const keep_alive = req.keep_alive();
+
+      // A middleware that answers leaves the body unread
+      auto&& sender = [this, body_unread](auto&& msg)
+      {
+         if (body_unread)
+            msg.keep_alive(false);
+         queue_(std::move(msg));
+      };
 
-         // Inform the queue that a write completed
-         if (self->queue_.next_task())
+      pipeline::context_type ctx;
+      if (!pipeline_->before(req, ctx, sender))
+      {
+         if (!body_unread && !queue_.is_full())
+            schedule_read();
+         return;
+      }
+
+      // The expectation is met here, as the upstream's own 100 Continue
+      // would only arrive after the body. Behind queued responses it goes
+      // unanswered and the client sends the body after its own wait.
+      if (body_unread && req.version() >= 11 && boost::beast::iequals(req[http::field::expect], "100-continue"))
+      {
+         req.erase(http::field::expect);
+         if (queue_.is_empty())
+            queue_(canned_response{boost::asio::buffer(continue_response, sizeof continue_response - 1), false});
+      }
+
+      // The upstream logs the request under the same ID
+      req.set("X-Request-Id", boost::beast::string_view{ctx.request_id.data(), ctx.request_id.size()});
+
+      // The op may outlive the session while its response is queued, so it
+      // must not keep the session alive
+      auto&& on_progress = [weak = this->weak_from_this()]()
+      {
+         // A body that keeps moving keeps the session open
+         if (auto self = weak.lock())
+            self->timer_.expires_after(self->timeout_);
+      };
+
+      auto&& on_response = [ self = this->shared_from_this(), ctx, version, keep_alive ](auto ec, auto op) mutable
+      {
+         using op_type = typename decltype(op)::element_type;
+
+         if (ec)
          {
-            // Read another request
-            self->schedule_read();
+            fail(ec, "proxy");
+
+            // Unless the request was read in full, the next one cannot be found
+            http::response<http::string_body> res{ec == boost::asio::error::timed_out ? http::status::gateway_timeout : http::status::bad_gateway, version};
+            res.keep_alive(keep_alive && op->request_relayed());
+            res.prepare_payload();
+            self->pipeline_->after(res, ctx);
+            self->queue_(std::move(res));
+         }
+         else
+         {
+            op->prepare_response(version, keep_alive);
+            self->pipeline_->after(op->response(), ctx);
+            self->queue_(proxied_response<op_type>{op});
          }
+
+         // Reading resumes only now, so pipelined responses stay in order
+         if (op->request_relayed() && !self->queue_.is_full())
+            self->schedule_read();
+      };
+
+      // The upstream has the session's whole timeout to answer
+      timer_.expires_after(timeout_);
+      proxy_->async_forward(socket_, buffer_, std::move(*parser_), timer_.expiry(), strand_, std::move(on_progress), std::move(on_response));
+      parser_.reset();
+   }
+
+   template <bool isRequest, class Body, class Fields>
+   void schedule_write(http::message<isRequest, Body, Fields>& msg)
+   {
+      auto&& on_write = [ self = this->shared_from_this(), close = msg.need_eof() ](auto ec, auto sz)
+      {
+         self->on_write(ec, close);
       };
 
       http::async_write(socket_, msg, boost::asio::bind_executor(strand_, std::move(on_write)));
    }
 
+   template <class Op>
+   void schedule_write(proxied_response<Op>& res)
+   {
+      auto&& on_write = [ self = this->shared_from_this(), op = res.op ](auto ec)
+      {
+         // A response cut short cannot be finished on this connection
+         if (ec && ec != boost::asio::error::operation_aborted)
+         {
+            fail(ec, "proxy");
+            return self->do_full_close();
+         }
+
+         self->on_write(ec, op->response().need_eof());
+      };
+
+      res.op->async_relay_response(std::move(on_write));
+   }
+
+   void schedule_write(canned_response& res)
+   {
+      auto&& on_write = [ self = this->shared_from_this(), close = res.close ](auto ec, auto)
+      {
+         self->on_write(ec, close);
+      };
+
+      boost::asio::async_write(socket_, res.bytes, boost::asio::bind_executor(strand_, std::move(on_write)));
+   }
+
+   void on_write(boost::system::error_code ec, bool close)
+   {
+      // Happens when the timer closes the socket
+      if (ec == boost::asio::error::operation_aborted)
+         return;
+
+      if (ec)
+         return fail(ec, "write");
+
+      if (close)
+      {
+         // This means we should close the connection, usually because
+         // the response indicated the "Connection: close" semantic.
+         return do_close();
+      }
+
+      // Inform the queue that a write completed
+      if (queue_.next_task())
+      {
+         // Read another request
+         schedule_read();
+      }
+   }
+
    void do_close()
    {
       // Send a TCP shutdown
       boost::system::error_code ec;
-      socket_.shutdown(tcp::socket::shutdown_send, ec);
+      socket_.shutdown(Socket::shutdown_send, ec);
    }
 
    void do_full_close()
    {
       // Send a TCP shutdown
       boost::system::error_code ec;
-      socket_.shutdown(tcp::socket::shutdown_both, ec);
+      socket_.shutdown(Socket::shutdown_both, ec);
 
       // Closing the socket cancels all outstanding operations. They
       // will complete with boost::asio::error::operation_aborted
@@ -262,35 +577,114 @@ public:
 
 int main(int argc, char* argv[])
 {
+   // Accepted connections get these options unless told otherwise
+   server_options options;
+   options.tuning.defer_accept   = std::chrono::seconds(5);
+   options.tuning.fastopen_queue = 256;
+
+   // Each client may send 1000 requests a second, in bursts of up to 2000
+   options.client_rate_limit = rate_limit{1000, 2000};
+
    // Check command line arguments.
-   if (argc != 4)
+   auto const first = parse_server_options(argc, argv, options);
+   auto const args  = argc - first;
+   if (first == 0 || (args != 3 && (args != 4 || !std::strchr(argv[first + 3], '='))))
    {
-      std::cerr << "Usage: sample_one <address> <port> <threads>\n"
+      std::cerr << "Usage: sample_one [<option>...] <address> <port> <threads> [<prefix>=<upstream>[,<upstream>...]]\n"
                 << "Example:\n"
-                << "    sample_one 0.0.0.0 8080 1\n";
+                << "    sample_one 0.0.0.0 8080 1\n"
+                << "    sample_one 0.0.0.0 8080 1 /api/=http://127.0.0.1:9000,https://127.0.0.1:9443\n"
+                << "    sample_one unix:/tmp/sample_one.sock 0 1\n"
+                << "    sample_one --rate-limit-exempt=127.0.0.1,::1 127.0.0.1 8080 1\n"
+                << "    sample_one --backlog=4096 --busy-poll=50 0.0.0.0 8080 1\n"
+                << "    sample_one --rate-limit=100,200 --route-rate-limit=/api/=10,20 0.0.0.0 8080 1\n"
+                << "The address may be unix:<path> for a Unix domain socket, the port is then ignored.\n"
+                << server_options_usage();
       return EXIT_FAILURE;
    }
 
-   auto const address = boost::asio::ip::make_address(argv[1]);
-   auto const port    = static_cast<unsigned short>(std::atoi(argv[2]));
-   auto const threads = std::max<int>(1, std::atoi(argv[3]));
+   std::string const address{argv[first]};
+   auto const port    = static_cast<unsigned short>(std::atoi(argv[first + 1]));
+   auto const threads = std::max<int>(1, std::atoi(argv[first + 2]));
+
+   // Hand over to the epoll build if the kernel refuses io_uring
+   if (!io_backend_available())
+   {
+      std::cerr << "The " << io_backend_name() << " I/O backend is not available, falling back to epoll\n";
+      exec_epoll_fallback(argv);
+      std::cerr << "Could not start the epoll build of " << argv[0] << "\n";
+      return EXIT_FAILURE;
+   }
 
    // The io_context is required for all I/O
    boost::asio::io_context ioc{threads};
 
-   // Create and launch a listening port
-   std::make_shared<listener<http_session>>(ioc, tcp::endpoint{address, port})->run();
+   std::cerr << "Using the " << io_backend_name() << " I/O backend\n";
+
+   // Access log lines go to stdout
+   log_writer access_log_writer{STDOUT_FILENO};
+
+   // These run around every request
+   auto hooks = std::make_shared<pipeline>(request_id{}, access_log{access_log_writer}, cors{"*"});
+
+   // Requests under the prefix are forwarded to the upstreams
+   std::shared_ptr<proxy> routes;
+   if (args == 4)
+   {
+      std::string const spec{argv[first + 3]};
+      auto const eq = spec.find('=');
+
+      routes = std::make_shared<proxy>(ioc, spec.substr(0, eq), std::chrono::seconds(10));
+
+      std::istringstream upstreams{spec.substr(eq + 1)};
+      for (std::string url; std::getline(upstreams, url, ',');)
+         routes->add_upstream(url, options.upstream);
+   }
+
+   // Clients are rate limited unless that is turned off. The limits were
+   // checked along with the options.
+   std::shared_ptr<rate_limiter> limits;
+   if (options.client_rate_limit)
+   {
+      limits = std::make_shared<rate_limiter>(*options.client_rate_limit);
+      for (auto const& route : options.route_rate_limits)
+         limits->add_route(route.first, route.second);
+      for (auto const& address : options.rate_limit_exempt)
+         limits->exempt(address);
+   }
+
+   // Create and launch a listening port, or a Unix domain socket
+   if (address.compare(0, 5, "unix:") == 0)
+   {
+      local::stream_protocol::endpoint endpoint{address.substr(5)};
+      std::make_shared<listener<http_session<local::stream_protocol::socket>, local::stream_protocol>>(ioc, endpoint, options.tuning)->run(hooks, routes, limits);
+   }
+   else
+   {
+      tcp::endpoint endpoint{boost::asio::ip::make_address(address), port};
+      std::make_shared<listener<http_session<tcp::socket>>>(ioc, endpoint, options.tuning)->run(hooks, routes, limits);
+   }
 
    // Capture SIGINT and SIGTERM to perform a clean shutdown
    boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
    signals.async_wait([&](boost::system::error_code const&, int) { ioc.stop(); });
 
-   // Run the I/O service on the requested number of threads
+   // Run the I/O service on the requested number of threads. Every thread
+   // regularly writes out the access log lines it has buffered.
+   auto&& run = [&ioc, &access_log_writer]
+   {
+      while (!ioc.stopped())
+      {
+         ioc.run_for(log_writer::flush_age);
+         access_log_writer.flush();
+      }
+   };
+
    std::vector<std::thread> v;
    v.reserve(threads - 1);
    for (auto i = threads - 1; i > 0; --i)
-      v.emplace_back([&ioc] { ioc.run(); });
-   ioc.run();
+      v.emplace_back(run);
+   run();
 
    // Block until all the threads exit
    for (auto& t : v)
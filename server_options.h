@@ -0,0 +1,168 @@
+#pragma once
+
+#include "endpoint.h"
+#include "proxy.h"
+#include "rate_limiter.h"
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/optional.hpp>
+
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Settings given on the command line as `--<name>=<value>`, ahead of the
+// positional arguments
+struct server_options
+{
+   // Requests each client may send, none if rate limiting is off
+   boost::optional<rate_limit> client_rate_limit;
+
+   // Further limits for each client on targets starting with a prefix
+   std::vector<std::pair<std::string, rate_limit>> route_rate_limits;
+
+   // Clients at these addresses are not rate limited, e.g. local benchmarks
+   // and sidecars
+   std::vector<boost::asio::ip::address> rate_limit_exempt;
+
+   // Options for the listening socket and the connections it accepts
+   socket_tuning tuning;
+
+   // How https upstreams are checked
+   upstream_tls upstream;
+};
+
+// Describes the options, for a usage message
+inline char const* server_options_usage()
+{
+   return "Options:\n"
+          "    --rate-limit=<per_second>,<burst>              requests each client may send, or off\n"
+          "    --route-rate-limit=<prefix>=<per_second>,<burst>\n"
+          "                                                   also limit each client on targets starting with <prefix>\n"
+          "    --rate-limit-exempt=<address>[,<address>...]   do not rate limit clients at these addresses\n"
+          "    --upstream-ca=<file>                           also trust the CA certificates in this PEM file\n"
+          "    --upstream-insecure                            do not verify https upstreams, e.g. self-signed ones\n"
+          "    --backlog=<connections>                        length of the queue of pending connections\n"
+          "    --send-buffer=<bytes>                          SO_SNDBUF, 0 keeps the kernel's default\n"
+          "    --receive-buffer=<bytes>                       SO_RCVBUF, 0 keeps the kernel's default\n"
+          "    --busy-poll=<microseconds>                     SO_BUSY_POLL on TCP connections, 0 is off\n"
+          "    --defer-accept=<seconds>                       TCP_DEFER_ACCEPT, 0 is off\n"
+          "    --fastopen-queue=<connections>                 TCP_FASTOPEN queue length, 0 is off\n";
+}
+
+// Reads all of `value` as a number from 0 to INT_MAX
+inline bool parse_count(std::string const& value, int& count)
+{
+   auto const end    = value.data() + value.size();
+   auto const result = std::from_chars(value.data(), end, count);
+   return !value.empty() && result.ec == std::errc{} && result.ptr == end && count >= 0;
+}
+
+// Reads `value` as `<per_second>,<burst>`. Reports what is wrong with it
+// and returns `false` if it is not a usable limit.
+inline bool parse_rate_limit(std::string const& value, rate_limit& limit)
+{
+   auto const comma = value.find(',');
+   if (comma == std::string::npos)
+      return false;
+
+   auto const end   = value.data() + value.size();
+   auto const rate  = std::from_chars(value.data(), value.data() + comma, limit.per_second);
+   auto const burst = std::from_chars(value.data() + comma + 1, end, limit.burst);
+   if (rate.ec != std::errc{} || rate.ptr != value.data() + comma || burst.ec != std::errc{} || burst.ptr != end || comma + 1 == value.size())
+      return false;
+
+   try
+   {
+      rate_limiter::validate(limit);
+   }
+   catch (std::invalid_argument const& e)
+   {
+      std::cerr << e.what() << "\n";
+      return false;
+   }
+
+   return true;
+}
+
+// Sets the socket option called `name` on the command line. Returns `false`
+// if there is none by that name.
+inline bool set_tuning(socket_tuning& tuning, std::string const& name, int count)
+{
+   if (name == "backlog")
+      tuning.backlog = count;
+   else if (name == "send-buffer")
+      tuning.send_buffer = count;
+   else if (name == "receive-buffer")
+      tuning.receive_buffer = count;
+   else if (name == "busy-poll")
+      tuning.busy_poll = std::chrono::microseconds(count);
+   else if (name == "defer-accept")
+      tuning.defer_accept = std::chrono::seconds(count);
+   else if (name == "fastopen-queue")
+      tuning.fastopen_queue = count;
+   else
+      return false;
+
+   return true;
+}
+
+// Reads the options at the start of argv[1..argc) over the defaults already
+// in `options`. Returns the index of the first positional argument, or 0
+// after reporting an option it cannot read.
+inline int parse_server_options(int argc, char* argv[], server_options& options)
+{
+   int i = 1;
+   for (; i < argc && std::strncmp(argv[i], "--", 2) == 0; ++i)
+   {
+      std::string const arg{argv[i]};
+      auto const eq    = arg.find('=');
+      auto const name  = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+      auto const value = eq == std::string::npos ? std::string{} : arg.substr(eq + 1);
+
+      rate_limit limit{};
+      if (name == "rate-limit" && value == "off")
+         options.client_rate_limit = boost::none;
+      else if (name == "rate-limit" && parse_rate_limit(value, limit))
+         options.client_rate_limit = limit;
+      else if (auto const split = value.rfind('='); name == "route-rate-limit" && split != std::string::npos && split > 0
+               && parse_rate_limit(value.substr(split + 1), limit))
+         options.route_rate_limits.emplace_back(value.substr(0, split), limit);
+      else if (name == "rate-limit-exempt" && !value.empty())
+      {
+         std::istringstream list{value};
+         for (std::string address; std::getline(list, address, ',');)
+         {
+            boost::system::error_code ec;
+            options.rate_limit_exempt.push_back(boost::asio::ip::make_address(address, ec));
+            if (ec)
+            {
+               std::cerr << "Not an IP address in " << arg << ": " << address << "\n";
+               return 0;
+            }
+         }
+      }
+      else if (name == "upstream-ca" && !value.empty())
+         options.upstream.ca_file = value;
+      else if (name == "upstream-insecure" && eq == std::string::npos)
+         options.upstream.verify = false;
+      else if (int count = 0; !parse_count(value, count) || !set_tuning(options.tuning, name, count))
+      {
+         std::cerr << "Unknown option or bad value: " << arg << "\n";
+         return 0;
+      }
+   }
+
+   if (!options.client_rate_limit && !options.route_rate_limits.empty())
+   {
+      std::cerr << "Route rate limits need --rate-limit to be on\n";
+      return 0;
+   }
+
+   return i;
+}
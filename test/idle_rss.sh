@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Parks COUNT idle keep-alive connections on a plain HTTP server and fails
+# if its resident memory grew by more than <max-bytes> per connection.
+#
+#   test/idle_rss.sh <server> <idle_clients> <port> <max-bytes>
+#
+# Exits with 77, which CTest reports as skipped, if the open file limit
+# cannot be raised far enough.
+
+set -e
+
+COUNT=${COUNT:-2000}
+
+server=$1
+clients=$2
+port=$3
+max=$4
+
+ulimit -n $((COUNT + 1024)) 2>/dev/null || exit 77
+
+"$server" --rate-limit=off 127.0.0.1 "$port" 1 >/dev/null 2>&1 &
+pid=$!
+sleep 1
+
+per_connection=$("$clients" 127.0.0.1 "$port" "$COUNT" "$pid" | awk '/^rss per idle connection:/ { print $5 }') || true
+
+kill "$pid"
+wait "$pid" 2>/dev/null || true
+
+echo "rss per idle connection: ${per_connection:-?} bytes, at most $max allowed"
+[ -n "$per_connection" ] && [ "$per_connection" -le "$max" ]
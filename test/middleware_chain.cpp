@@ -0,0 +1,271 @@
+#include "middleware.h"
+
+#include <boost/beast/http.hpp>
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace http = boost::beast::http;   // from <boost/beast/http.hpp>
+
+// Checks the order middleware_chain runs its hooks in, also when before()
+// and after() are called apart, that a middleware can answer in place of the
+// handler, and that the context reaches every hook. Then checks what the
+// request_id, cors and access_log middlewares add.
+
+static int failures = 0;
+
+static void check(bool ok, char const* what)
+{
+   if (!ok)
+   {
+      std::cerr << "FAILED: " << what << "\n";
+      ++failures;
+   }
+}
+
+using trace = std::vector<std::string>;
+
+// Records its hooks, and answers with 403 when the request has `stop` set
+template <char Name>
+class recorder
+{
+   trace* trace_;
+
+public:
+   struct context
+   {
+      bool seen = false;
+   };
+
+   explicit recorder(trace& t)
+      : trace_(&t)
+   {
+   }
+
+   template <class Request, class Context, class Respond>
+   bool before(Request& req, Context& ctx, Respond& respond)
+   {
+      trace_->push_back(std::string{"before "} + Name);
+      ctx.recorder<Name>::context::seen = true;
+
+      auto const stop = req["stop"];
+      if (stop.size() != 1 || stop[0] != Name)
+         return true;
+
+      http::response<http::empty_body> res{http::status::forbidden, req.version()};
+      respond(std::move(res));
+      return false;
+   }
+
+   template <class Message, class Context>
+   void after(Message& res, Context& ctx)
+   {
+      trace_->push_back(std::string{"after "} + Name);
+      res.set(std::string{"x-"} + Name, ctx.recorder<Name>::context::seen ? "seen" : "unseen");
+   }
+};
+
+struct sender
+{
+   trace* trace_;
+   std::vector<http::response<http::empty_body>> sent;
+
+   template <class Message>
+   void operator()(Message&& msg)
+   {
+      trace_->push_back("send " + std::to_string(msg.result_int()));
+      http::response<http::empty_body> res{msg.result(), msg.version()};
+      for (auto const& field : msg)
+         res.set(field.name_string(), field.value());
+      sent.push_back(std::move(res));
+   }
+};
+
+using chain = middleware_chain<recorder<'a'>, recorder<'b'>, recorder<'c'>>;
+
+static trace run(chain& c, trace& t, sender& s, char const* stop)
+{
+   t.clear();
+   s.sent.clear();
+
+   http::request<http::empty_body> req{http::verb::get, "/", 11};
+   if (stop)
+      req.set("stop", stop);
+
+   c(std::move(req),
+     [&t](auto&&, auto& ctx, auto& respond)
+     {
+        t.push_back("handler");
+        chain::context_type& typed = ctx;
+        check(typed.recorder<'a'>::context::seen && typed.recorder<'c'>::context::seen, "handler sees every context");
+
+        http::response<http::empty_body> res{http::status::ok, 11};
+        respond(std::move(res));
+     },
+     s);
+
+   return t;
+}
+
+// Sends `req` through `c` to a handler that answers 200, and returns what
+// was sent. `handled` tells whether the handler was reached.
+template <class Chain>
+static std::vector<http::response<http::empty_body>> serve(Chain& c, http::request<http::empty_body> req, bool& handled)
+{
+   trace t;
+   sender s{&t, {}};
+   handled = false;
+
+   c(std::move(req),
+     [&handled](auto&& req, auto&, auto& respond)
+     {
+        handled = true;
+        http::response<http::empty_body> res{http::status::ok, req.version()};
+        respond(std::move(res));
+     },
+     s);
+
+   return std::move(s.sent);
+}
+
+static void check_request_id()
+{
+   middleware_chain<request_id> c{request_id{}};
+   bool handled = false;
+
+   // A given ID is kept
+   http::request<http::empty_body> req{http::verb::get, "/", 11};
+   req.set("X-Request-Id", "abc-123");
+   auto sent = serve(c, req, handled);
+   check(sent.size() == 1 && sent[0]["X-Request-Id"] == "abc-123", "request_id echoes a given ID");
+
+   // Otherwise, and for one too long to keep, each request gets a new one
+   auto const first = serve(c, {http::verb::get, "/", 11}, handled);
+   auto const second = serve(c, {http::verb::get, "/", 11}, handled);
+   check(first.size() == 1 && !first[0]["X-Request-Id"].empty(), "request_id generates an ID");
+   check(second.size() == 1 && first[0]["X-Request-Id"] != second[0]["X-Request-Id"], "request_id generates distinct IDs");
+
+   req.set("X-Request-Id", std::string(41, 'x'));
+   sent = serve(c, req, handled);
+   check(sent.size() == 1 && !sent[0]["X-Request-Id"].empty() && sent[0]["X-Request-Id"] != req["X-Request-Id"],
+         "request_id replaces an ID too long to keep");
+}
+
+static void check_cors()
+{
+   middleware_chain<cors> specific{cors{"https://app.example"}};
+   bool handled = false;
+
+   // A preflight is answered without reaching the handler
+   http::request<http::empty_body> preflight{http::verb::options, "/api", 11};
+   preflight.set(http::field::origin, "https://app.example");
+   preflight.set(http::field::access_control_request_method, "POST");
+   auto sent = serve(specific, preflight, handled);
+   check(!handled && sent.size() == 1 && sent[0].result() == http::status::no_content, "cors answers a preflight with 204");
+   check(sent.size() == 1 && sent[0][http::field::access_control_allow_origin] == "https://app.example"
+            && sent[0][http::field::access_control_allow_methods] == "GET, POST, PUT, DELETE"
+            && sent[0][http::field::access_control_allow_headers] == "Content-Type"
+            && sent[0][http::field::access_control_max_age] == "86400" && sent[0][http::field::vary] == "Origin",
+         "cors preflight headers");
+
+   // A cross-origin request from the allowed origin is marked, and as the
+   // answer depends on the origin, caches are told so
+   http::request<http::empty_body> req{http::verb::get, "/api", 11};
+   req.set(http::field::origin, "https://app.example");
+   sent = serve(specific, req, handled);
+   check(handled && sent.size() == 1 && sent[0][http::field::access_control_allow_origin] == "https://app.example"
+            && sent[0][http::field::vary] == "Origin",
+         "cors allows the configured origin, with Vary");
+
+   req.set(http::field::origin, "https://other.example");
+   sent = serve(specific, req, handled);
+   check(handled && sent.size() == 1 && sent[0][http::field::access_control_allow_origin].empty(), "cors ignores other origins");
+
+   preflight.set(http::field::origin, "https://other.example");
+   sent = serve(specific, preflight, handled);
+   check(handled && sent.size() == 1 && sent[0].result() == http::status::ok, "cors leaves other origins' preflights to the handler");
+
+   // Any origin gets "*", which needs no Vary
+   middleware_chain<cors> any{cors{"*"}};
+   req.set(http::field::origin, "https://other.example");
+   sent = serve(any, req, handled);
+   check(sent.size() == 1 && sent[0][http::field::access_control_allow_origin] == "*" && sent[0][http::field::vary].empty(),
+         "cors with * allows any origin without Vary");
+}
+
+static void check_access_log()
+{
+   int fds[2];
+   if (::pipe(fds) != 0)
+      return check(false, "access_log pipe");
+
+   log_writer writer{fds[1]};
+   middleware_chain<access_log> c{access_log{writer}};
+   bool handled = false;
+
+   serve(c, {http::verb::post, "/logged?x=1", 11}, handled);
+   writer.flush();
+
+   char buf[256];
+   auto const n = ::read(fds[0], buf, sizeof(buf));
+   std::string const line{buf, n > 0 ? std::size_t(n) : 0};
+   auto const prefix = std::string{"POST /logged?x=1 200 "};
+   check(line.compare(0, prefix.size(), prefix) == 0 && line.size() > prefix.size() + 3
+            && line.compare(line.size() - 3, 3, "us\n") == 0,
+         "access_log writes method, target, status and time");
+
+   ::close(fds[0]);
+   ::close(fds[1]);
+}
+
+int main()
+{
+   trace t;
+   sender s{&t, {}};
+   chain c{recorder<'a'>{t}, recorder<'b'>{t}, recorder<'c'>{t}};
+
+   // Every hook runs, `after` in reverse order, around the handler
+   check(run(c, t, s, nullptr) == trace{"before a", "before b", "before c", "handler", "after c", "after b", "after a", "send 200"},
+         "full chain order");
+   check(s.sent.size() == 1 && s.sent[0]["x-a"] == "seen" && s.sent[0]["x-c"] == "seen", "after hooks see the context");
+
+   // A middleware that answers stops the chain, and its response only passes
+   // the middlewares before it
+   check(run(c, t, s, "b") == trace{"before a", "before b", "after a", "send 403"}, "short-circuit order");
+   check(s.sent.size() == 1 && s.sent[0].result() == http::status::forbidden, "short-circuit response is sent");
+   check(s.sent.size() == 1 && s.sent[0]["x-a"] == "seen" && s.sent[0]["x-b"].empty() && s.sent[0]["x-c"].empty(),
+         "short-circuit skips later after hooks");
+
+   check(run(c, t, s, "a") == trace{"before a", "send 403"}, "first middleware answers alone");
+
+   // Split in two, as for a proxied request answered later, the hooks run in
+   // the same order
+   t.clear();
+   s.sent.clear();
+   http::request<http::empty_body> req{http::verb::get, "/", 11};
+   chain::context_type ctx;
+   check(c.before(req, ctx, s), "split before passes");
+
+   http::response<http::empty_body> res{http::status::ok, 11};
+   c.after(res, ctx);
+   check(t == trace{"before a", "before b", "before c", "after c", "after b", "after a"}, "split chain order");
+   check(res["x-a"] == "seen" && res["x-c"] == "seen" && s.sent.empty(), "split after hooks see the context");
+
+   t.clear();
+   req.set("stop", "c");
+   chain::context_type stopped;
+   check(!c.before(req, stopped, s), "split before stops");
+   check(t == trace{"before a", "before b", "before c", "after b", "after a", "send 403"}, "split short-circuit order");
+
+   check_request_id();
+   check_cors();
+   check_access_log();
+
+   if (failures == 0)
+      std::cout << "middleware_chain: all checks passed\n";
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}